@@ -0,0 +1,792 @@
+
+//	ImageConvert / ImageHalftoning / ImageBlend / ImageBitPack performance test.
+//
+//	g++ -O3 -std=c++11 PerfTest_ImageConvert.cpp -o PerfTest_ImageConvert.o -pthread
+//
+//	./PerfTest_ImageConvert.o [-n samples] [-warmup count] [-label name] [-csv file]
+//
+//	Every function is measured on the panel sizes, odd widths and unaligned
+//	strides below. Each sample is a single call; the reported value is the
+//	median of all samples. With -csv the results are also written as CSV so
+//	that runs of different kernel versions (use -label) can be compared.
+//	Functions that have a bit-identical reference (ErrDiffParallel_*) are
+//	also checked against it; a mismatch is reported and the exit code is -1.
+//	ImageConvert, ImageBitPack and the ImageBlend kernels are fuzzed against
+//	their scalar references before measuring.
+
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <chrono>
+
+#include "common/img_conv.h"
+#include "common/img_halftone.h"
+#include "common/img_blend.h"
+#include "common/img_bitpack.h"
+
+
+#define	PAIR_CONV				std::pair<void (*)(const uint8_t* pSrcImage, int nSrcStride, int cx, int cy, uint8_t * pDstImage, int nDstStride),const char*>
+#define	MAKE_CONV_PAIR(func)	PAIR_CONV(func,#func)
+
+#define	PAIR_HALF				std::pair<void (*)(uint8_t * image, int stride, int width, int height),const char*>
+#define	MAKE_HALF_PAIR(func)	PAIR_HALF(func,#func)
+
+
+class PerfImageSize
+{
+public:
+	PerfImageSize( int w, int h, bool unaligned )
+	{
+		width		= w;
+		height		= h;
+		isUnaligned	= unaligned;
+	}
+
+	// Unaligned strides keep the pixel alignment but break 16 byte row alignment.
+	int		GetStride( int BytesPerPixel ) const
+	{
+		return	width * BytesPerPixel + (isUnaligned ? (1 == BytesPerPixel ? 3 : BytesPerPixel) : 0);
+	}
+
+public:
+	int		width;
+	int		height;
+	bool	isUnaligned;
+};
+
+
+class PerfResult
+{
+public:
+	PerfResult( const char* name, const PerfImageSize& size, int stride, double median_ns )
+	{
+		m_strName	= name;
+		m_nWidth	= size.width;
+		m_nHeight	= size.height;
+		m_nStride	= stride;
+		m_dMedianNs	= median_ns;
+	}
+
+	double	GetMpixPerSec() const
+	{
+		return	m_nWidth * (double)m_nHeight * 1000.0 / m_dMedianNs;
+	}
+
+	double	GetNsPerPixel() const
+	{
+		return	m_dMedianNs / (m_nWidth * (double)m_nHeight);
+	}
+
+public:
+	std::string		m_strName;
+	int				m_nWidth;
+	int				m_nHeight;
+	int				m_nStride;
+	double			m_dMedianNs;
+};
+
+
+static	void	A8overRGB565_Gray( const uint8_t* pSrcImage, int nSrcStride, int cx, int cy, uint8_t * pDstImage, int nDstStride )
+{
+	ImageBlend::A8overRGB565( pSrcImage, nSrcStride, cx, cy, 0xFF808080, pDstImage, nDstStride );
+}
+
+static	void	A8overRGB565_Gray_C( const uint8_t* pSrcImage, int nSrcStride, int cx, int cy, uint8_t * pDstImage, int nDstStride )
+{
+	ImageBlend::A8overRGB565_C( pSrcImage, nSrcStride, cx, cy, 0xFF808080, pDstImage, nDstStride );
+}
+
+
+static	void	A8overGRAY8_White( const uint8_t* pSrcImage, int nSrcStride, int cx, int cy, uint8_t * pDstImage, int nDstStride )
+{
+	ImageBlend::A8overGRAY8( pSrcImage, nSrcStride, cx, cy, 0xFF, pDstImage, nDstStride );
+}
+
+static	void	A8overGRAY8_White_C( const uint8_t* pSrcImage, int nSrcStride, int cx, int cy, uint8_t * pDstImage, int nDstStride )
+{
+	ImageBlend::A8overGRAY8_C( pSrcImage, nSrcStride, cx, cy, 0xFF, pDstImage, nDstStride );
+}
+
+static	void	A8overBGRA8888_White( const uint8_t* pSrcImage, int nSrcStride, int cx, int cy, uint8_t * pDstImage, int nDstStride )
+{
+	ImageBlend::A8overBGRA8888( pSrcImage, nSrcStride, cx, cy, 0xFFFFFFFF, pDstImage, nDstStride );
+}
+
+static	void	A8overBGRA8888_White_C( const uint8_t* pSrcImage, int nSrcStride, int cx, int cy, uint8_t * pDstImage, int nDstStride )
+{
+	ImageBlend::A8overBGRA8888_C( pSrcImage, nSrcStride, cx, cy, 0xFFFFFFFF, pDstImage, nDstStride );
+}
+
+
+static	void	OrderedDither_Bayer8( uint8_t * image, int stride, int width, int height )
+{
+	ImageHalftoning::OrderedDither( image, stride, width, height, ImageHalftoning::ThresholdMatrix::Bayer( 8 ) );
+}
+
+static	void	OrderedDither_BlueNoise( uint8_t * image, int stride, int width, int height )
+{
+	ImageHalftoning::OrderedDither( image, stride, width, height, ImageHalftoning::ThresholdMatrix::BlueNoise() );
+}
+
+static	void	PatternDither_Bayer4( uint8_t * image, int stride, int width, int height )
+{
+	ImageHalftoning::PatternDither( image, stride, width, height, ImageHalftoning::ThresholdMatrix::Bayer( 4 ) );
+}
+
+
+static	void	FillTestImage( std::vector<uint8_t>& image, int BytesPerPixel, int stride, int cx, int cy )
+{
+	uint32_t	seed	= 0x12345678;
+
+	image.assign( stride * cy, 0 );
+
+	for( int y = 0; y < cy; y++ )
+	{
+		uint8_t*	line	= &image[ stride * y ];
+
+		for( int x = 0; x < cx * BytesPerPixel; x++ )
+		{
+			// gradient + noise, so that halftoning has real work to do.
+			seed	= seed * 1103515245 + 12345;
+			line[x]	= (uint8_t)( (x * 255 / (cx * BytesPerPixel)) / 2 + ((seed >> 16) & 0x7F) );
+		}
+	}
+}
+
+
+// Scalar references of ImageConvert, one pixel at a time.
+// RGB565 is MSB first, RGB565L is in host byte order (fbdev).
+static	void	StoreRGB565( uint8_t* d, uint32_t r, uint32_t g, uint32_t b )
+{
+	uint32_t	p	= ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+
+	d[0]	= (uint8_t)(p >> 8);
+	d[1]	= (uint8_t)(p >> 0);
+}
+
+static	void	StoreRGB565L( uint8_t* d, uint32_t r, uint32_t g, uint32_t b )
+{
+	uint16_t	p	= (uint16_t)(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+
+	memcpy( d, &p, 2 );
+}
+
+static	void	LoadRGB565( const uint8_t* s, uint32_t& r, uint32_t& g, uint32_t& b )
+{
+	uint32_t	p	= (s[0] << 8) | s[1];
+
+	r	= (p >> 11);
+	g	= (p >>  5) & 0x3F;
+	b	= (p >>  0) & 0x1F;
+
+	r	= (r << 3) | (r >> 2);
+	g	= (g << 2) | (g >> 4);
+	b	= (b << 3) | (b >> 2);
+}
+
+static	void	BGRA8888toGRAY8_Pixel( const uint8_t* s, uint8_t* d )	{ d[0] = (uint8_t)((s[0] * 4732 + s[1] * 46871 + s[2] * 13933) >> 16); }
+static	void	BGRA8888toRGB565_Pixel( const uint8_t* s, uint8_t* d )	{ StoreRGB565( d, s[2], s[1], s[0] ); }
+static	void	BGRA8888toRGB888_Pixel( const uint8_t* s, uint8_t* d )	{ d[0] = s[2]; d[1] = s[1]; d[2] = s[0]; }
+static	void	BGRA8888toRGB565L_Pixel( const uint8_t* s, uint8_t* d )	{ StoreRGB565L( d, s[2], s[1], s[0] ); }
+static	void	GRAY8toRGB565_Pixel( const uint8_t* s, uint8_t* d )		{ StoreRGB565( d, s[0], s[0], s[0] ); }
+static	void	GRAY8toRGB888_Pixel( const uint8_t* s, uint8_t* d )		{ d[0] = s[0]; d[1] = s[0]; d[2] = s[0]; }
+static	void	GRAY8toRGB565L_Pixel( const uint8_t* s, uint8_t* d )		{ StoreRGB565L( d, s[0], s[0], s[0] ); }
+static	void	RGB565toRGB565L_Pixel( const uint8_t* s, uint8_t* d )	{ uint16_t p = (uint16_t)((s[0] << 8) | s[1]); memcpy( d, &p, 2 ); }
+static	void	RGB565toRGB888_Pixel( const uint8_t* s, uint8_t* d )		{ uint32_t r, g, b; LoadRGB565( s, r, g, b ); d[0] = r; d[1] = g; d[2] = b; }
+static	void	RGB565toBGRA8888_Pixel( const uint8_t* s, uint8_t* d )	{ uint32_t r, g, b; LoadRGB565( s, r, g, b ); d[0] = b; d[1] = g; d[2] = r; d[3] = 0xFF; }
+
+template<int SRC_BPP, int DST_BPP, void (*PIXEL)( const uint8_t* s, uint8_t* d )>
+static	void	ConvertRef( const uint8_t* pSrcImage, int nSrcStride, int cx, int cy, uint8_t * pDstImage, int nDstStride )
+{
+	for( int y = 0; y < cy; y++ )
+	{
+		for( int x = 0; x < cx; x++ )
+		{
+			PIXEL( &pSrcImage[ nSrcStride * y + x * SRC_BPP ], &pDstImage[ nDstStride * y + x * DST_BPP ] );
+		}
+	}
+}
+
+
+// Random sizes / strides / values, every ImageConvert function vs. its
+// scalar reference. Returns the number of mismatches.
+static	int		FuzzConvert( int nCount )
+{
+	uint32_t	seed	= 0x6C078965;
+	int			nFails	= 0;
+
+	auto	Rand	= [&]()
+	{
+		seed	= seed * 1103515245 + 12345;
+		return	(int)(seed >> 8);
+	};
+
+	struct	CONV_REF
+	{
+		PAIR_CONV	func;
+		PAIR_CONV	ref;
+		int			nSrcBpp;
+		int			nDstBpp;
+	};
+
+	const CONV_REF	iConv[]	=
+	{
+		{ MAKE_CONV_PAIR(ImageConvert::BGRA8888toGRAY8),	MAKE_CONV_PAIR((ConvertRef<4,1,BGRA8888toGRAY8_Pixel>)),	4, 1 },
+		{ MAKE_CONV_PAIR(ImageConvert::BGRA8888toRGB565),	MAKE_CONV_PAIR((ConvertRef<4,2,BGRA8888toRGB565_Pixel>)),	4, 2 },
+		{ MAKE_CONV_PAIR(ImageConvert::BGRA8888toRGB888),	MAKE_CONV_PAIR((ConvertRef<4,3,BGRA8888toRGB888_Pixel>)),	4, 3 },
+		{ MAKE_CONV_PAIR(ImageConvert::BGRA8888toRGB565L),	MAKE_CONV_PAIR((ConvertRef<4,2,BGRA8888toRGB565L_Pixel>)),	4, 2 },
+		{ MAKE_CONV_PAIR(ImageConvert::GRAY8toRGB565),		MAKE_CONV_PAIR((ConvertRef<1,2,GRAY8toRGB565_Pixel>)),		1, 2 },
+		{ MAKE_CONV_PAIR(ImageConvert::GRAY8toRGB888),		MAKE_CONV_PAIR((ConvertRef<1,3,GRAY8toRGB888_Pixel>)),		1, 3 },
+		{ MAKE_CONV_PAIR(ImageConvert::GRAY8toRGB565L),		MAKE_CONV_PAIR((ConvertRef<1,2,GRAY8toRGB565L_Pixel>)),		1, 2 },
+		{ MAKE_CONV_PAIR(ImageConvert::RGB565toRGB565L),	MAKE_CONV_PAIR((ConvertRef<2,2,RGB565toRGB565L_Pixel>)),	2, 2 },
+		{ MAKE_CONV_PAIR(ImageConvert::RGB565toRGB888),		MAKE_CONV_PAIR((ConvertRef<2,3,RGB565toRGB888_Pixel>)),		2, 3 },
+		{ MAKE_CONV_PAIR(ImageConvert::RGB565toBGRA8888),	MAKE_CONV_PAIR((ConvertRef<2,4,RGB565toBGRA8888_Pixel>)),	2, 4 },
+	};
+
+	for( int i = 0; i < nCount; i++ )
+	{
+		for( auto& conv : iConv )
+		{
+			// strides keep the pixel alignment, as PerfImageSize.
+			int						cx			= 1 + Rand() % 100;
+			int						cy			= 1 + Rand() % 8;
+			int						nSrcStride	= (cx + Rand() % 5) * conv.nSrcBpp;
+			int						nDstStride	= (cx + Rand() % 5) * conv.nDstBpp;
+			std::vector<uint8_t>	src( nSrcStride * cy );
+			std::vector<uint8_t>	dst( nDstStride * cy );
+
+			for( auto& pixel : src )
+			{
+				pixel	= (uint8_t)Rand();
+			}
+
+			for( auto& pixel : dst )
+			{
+				pixel	= (uint8_t)Rand();
+			}
+
+			std::vector<uint8_t>	ref( dst );
+
+			conv.func.first( src.data(), nSrcStride, cx, cy, dst.data(), nDstStride );
+			conv.ref.first( src.data(), nSrcStride, cx, cy, ref.data(), nDstStride );
+
+			if( dst != ref )
+			{
+				if( 0 == nFails )
+				{
+					printf( "ERROR: %s differs from %s\n", conv.func.second, conv.ref.second );
+				}
+
+				nFails++;
+			}
+		}
+	}
+
+	return	nFails;
+}
+
+
+// Random sizes / strides / values, optimized vs. reference. Returns the number of mismatches.
+static	int		FuzzBitPack( int nCount )
+{
+	uint32_t	seed	= 0x9E3779B9;
+	int			nFails	= 0;
+
+	auto	Rand	= [&]()
+	{
+		seed	= seed * 1103515245 + 12345;
+		return	(int)(seed >> 8);
+	};
+
+	for( int i = 0; i < nCount; i++ )
+	{
+		uint64_t	v	= ((uint64_t)Rand() << 40) ^ ((uint64_t)Rand() << 20) ^ (uint64_t)Rand();
+
+		if( ImageBitPack::Transpose8x8( v ) != ImageBitPack::Transpose8x8_C( v ) )
+		{
+			nFails++;
+		}
+	}
+
+	for( int i = 0; i < nCount; i++ )
+	{
+		int						cx			= 1 + Rand() % 200;
+		int						cy			= 1 + Rand() % 70;
+		int						nSrcStride	= cx + Rand() % 9;
+		int						nDstStride	= cx + Rand() % 5;
+		std::vector<uint8_t>	src( nSrcStride * cy );
+		std::vector<uint8_t>	dst( nDstStride * ((cy + 7) / 8), 0xAA );
+		std::vector<uint8_t>	ref( dst );
+
+		for( auto& pixel : src )
+		{
+			pixel	= (uint8_t)Rand();
+		}
+
+		ImageBitPack::GRAY8toPages( src.data(), nSrcStride, cx, cy, dst.data(), nDstStride );
+		ImageBitPack::GRAY8toPages_C( src.data(), nSrcStride, cx, cy, ref.data(), nDstStride );
+
+		if( dst != ref )
+		{
+			nFails++;
+		}
+
+		// transposed (90/270)
+		nDstStride	= cy + Rand() % 5;
+		dst.assign( nDstStride * ((cx + 7) / 8), 0xAA );
+		ref	= dst;
+
+		ImageBitPack::GRAY8toPagesT( src.data(), nSrcStride, cx, cy, dst.data(), nDstStride );
+		ImageBitPack::GRAY8toPagesT_C( src.data(), nSrcStride, cx, cy, ref.data(), nDstStride );
+
+		if( dst != ref )
+		{
+			nFails++;
+		}
+	}
+
+	return	nFails;
+}
+
+
+// Random coverage (with 0x00 / 0xFF runs, as glyphs), colors and sizes,
+// optimized vs. reference. Returns the number of mismatches.
+static	int		FuzzBlendA8( int nCount )
+{
+	uint32_t	seed	= 0x7F4A7C15;
+	int			nFails	= 0;
+
+	auto	Rand	= [&]()
+	{
+		seed	= seed * 1103515245 + 12345;
+		return	(int)(seed >> 8);
+	};
+
+	for( int i = 0; i < nCount; i++ )
+	{
+		int						cx			= 1 + Rand() % 100;
+		int						cy			= 1 + Rand() % 8;
+		int						nMaskStride	= cx + Rand() % 9;
+		uint32_t				color		= ((uint32_t)Rand() << 8) ^ (uint32_t)Rand();
+		std::vector<uint8_t>	mask( nMaskStride * cy );
+
+		color	= 0 == (i & 1) ? (color | 0xFF000000) : color;
+
+		for( size_t n = 0; n < mask.size(); )
+		{
+			int		run		= 1 + Rand() % 24;
+			int		kind	= Rand() % 3;
+
+			for( ; (0 < run) && (n < mask.size()); run--, n++ )
+			{
+				mask[n]	= 0 == kind ? 0x00 : 1 == kind ? 0xFF : (uint8_t)Rand();
+			}
+		}
+
+		for( int bpp : { 1, 2, 4 } )
+		{
+			int						nDstStride	= cx * bpp + Rand() % 5;
+			std::vector<uint8_t>	dst( nDstStride * cy );
+
+			for( auto& pixel : dst )
+			{
+				pixel	= (uint8_t)Rand();
+			}
+
+			std::vector<uint8_t>	ref( dst );
+
+			if( 1 == bpp )
+			{
+				ImageBlend::A8overGRAY8( mask.data(), nMaskStride, cx, cy, (uint8_t)color, dst.data(), nDstStride );
+				ImageBlend::A8overGRAY8_C( mask.data(), nMaskStride, cx, cy, (uint8_t)color, ref.data(), nDstStride );
+			}
+			else if( 2 == bpp )
+			{
+				ImageBlend::A8overRGB565( mask.data(), nMaskStride, cx, cy, color, dst.data(), nDstStride );
+				ImageBlend::A8overRGB565_C( mask.data(), nMaskStride, cx, cy, color, ref.data(), nDstStride );
+			}
+			else
+			{
+				ImageBlend::A8overBGRA8888( mask.data(), nMaskStride, cx, cy, color, dst.data(), nDstStride );
+				ImageBlend::A8overBGRA8888_C( mask.data(), nMaskStride, cx, cy, color, ref.data(), nDstStride );
+			}
+
+			if( dst != ref )
+			{
+				nFails++;
+			}
+		}
+	}
+
+	return	nFails;
+}
+
+
+// Random premultiplied BGRA sources (with alpha 0x00 / 0xFF runs), sizes,
+// strides and unaligned rows, optimized vs. reference. Returns the number of mismatches.
+static	int		FuzzBlendBGRA( int nCount )
+{
+	uint32_t	seed	= 0x2545F491;
+	int			nFails	= 0;
+
+	auto	Rand	= [&]()
+	{
+		seed	= seed * 1103515245 + 12345;
+		return	(int)(seed >> 8);
+	};
+
+	for( int i = 0; i < nCount; i++ )
+	{
+		int						cx			= 1 + Rand() % 100;
+		int						cy			= 1 + Rand() % 8;
+		int						nSrcOffset	= Rand() % 4;
+		int						nSrcStride	= cx * 4 + Rand() % 9;
+		std::vector<uint8_t>	src( nSrcOffset + nSrcStride * cy );
+
+		for( int y = 0; y < cy; y++ )
+		{
+			uint8_t*	s	= &src[ nSrcOffset + nSrcStride * y ];
+
+			for( int x = 0; x < cx; )
+			{
+				int		run		= 1 + Rand() % 24;
+				int		kind	= Rand() % 3;
+
+				for( ; (0 < run) && (x < cx); run--, x++ )
+				{
+					int		a	= 0 == kind ? 0x00 : 1 == kind ? 0xFF : Rand() & 0xFF;
+
+					s[x*4+0]	= (uint8_t)(Rand() % (a + 1));
+					s[x*4+1]	= (uint8_t)(Rand() % (a + 1));
+					s[x*4+2]	= (uint8_t)(Rand() % (a + 1));
+					s[x*4+3]	= (uint8_t)a;
+				}
+			}
+		}
+
+		for( int bpp : { 2, 4 } )
+		{
+			int						nDstOffset	= Rand() % 4;
+			int						nDstStride	= cx * bpp + Rand() % 5;
+			std::vector<uint8_t>	dst( nDstOffset + nDstStride * cy );
+
+			for( auto& pixel : dst )
+			{
+				pixel	= (uint8_t)Rand();
+			}
+
+			std::vector<uint8_t>	ref( dst );
+
+			if( 2 == bpp )
+			{
+				ImageBlend::BGRA8888overRGB565( &src[nSrcOffset], nSrcStride, cx, cy, &dst[nDstOffset], nDstStride );
+				ImageBlend::BGRA8888overRGB565_C( &src[nSrcOffset], nSrcStride, cx, cy, &ref[nDstOffset], nDstStride );
+			}
+			else
+			{
+				ImageBlend::BGRA8888overBGRA8888( &src[nSrcOffset], nSrcStride, cx, cy, &dst[nDstOffset], nDstStride );
+				ImageBlend::BGRA8888overBGRA8888_C( &src[nSrcOffset], nSrcStride, cx, cy, &ref[nDstOffset], nDstStride );
+			}
+
+			if( dst != ref )
+			{
+				nFails++;
+			}
+		}
+	}
+
+	return	nFails;
+}
+
+
+// prepare() runs before every call and is not measured.
+template<class Prepare, class Func>
+static	double	MeasureMedian( int nWarmup, int nSamples, Prepare prepare, Func func )
+{
+	std::vector<double>	iSamples;
+
+	for( int i = 0; i < nWarmup; i++ )
+	{
+		prepare();
+		func();
+	}
+
+	for( int i = 0; i < nSamples; i++ )
+	{
+		std::chrono::high_resolution_clock::time_point	st,et;
+
+		prepare();
+
+		st	= std::chrono::high_resolution_clock::now();
+		func();
+		et	= std::chrono::high_resolution_clock::now();
+
+		iSamples.push_back( std::chrono::duration_cast<std::chrono::nanoseconds>(et-st).count() );
+	}
+
+	std::sort( iSamples.begin(), iSamples.end() );
+
+	return	iSamples[ iSamples.size() / 2 ];
+}
+
+
+static	void	ShowResult( const PerfResult& result )
+{
+	printf( "|%-48s|%4d x %-4d|%6d|%10.3f Mpix/s|%9.3f ns/pix|\n",
+		result.m_strName.c_str(),
+		result.m_nWidth,
+		result.m_nHeight,
+		result.m_nStride,
+		result.GetMpixPerSec(),
+		result.GetNsPerPixel() );
+}
+
+
+int main( int argc, char* argv[] )
+{
+	int				nSamples	= 31;
+	int				nWarmup		= 5;
+	const char*		pszLabel	= "default";
+	const char*		pszCsvPath	= NULL;
+
+	for( int i = 1; i < argc; i++ )
+	{
+		if( (0 == strcmp( argv[i], "-n" )) && ((i+1) < argc) )
+		{
+			nSamples	= atoi( argv[++i] );
+		}
+		else if( (0 == strcmp( argv[i], "-warmup" )) && ((i+1) < argc) )
+		{
+			nWarmup		= atoi( argv[++i] );
+		}
+		else if( (0 == strcmp( argv[i], "-label" )) && ((i+1) < argc) )
+		{
+			pszLabel	= argv[++i];
+		}
+		else if( (0 == strcmp( argv[i], "-csv" )) && ((i+1) < argc) )
+		{
+			pszCsvPath	= argv[++i];
+		}
+		else
+		{
+			printf( "usage: %s [-n samples] [-warmup count] [-label name] [-csv file]\n", argv[0] );
+			return	-1;
+		}
+	}
+
+	nSamples	= 0 < nSamples ? nSamples : 1;
+
+
+	std::vector<PerfImageSize>	iSizes;
+
+	// Panel sizes
+	iSizes.push_back( PerfImageSize( 128,  64, false ) );
+	iSizes.push_back( PerfImageSize( 240, 240, false ) );
+	iSizes.push_back( PerfImageSize( 320, 240, false ) );
+	iSizes.push_back( PerfImageSize( 480, 320, false ) );
+
+	// Odd widths
+	iSizes.push_back( PerfImageSize( 127,  63, false ) );
+	iSizes.push_back( PerfImageSize( 239, 239, false ) );
+
+	// Unaligned strides
+	iSizes.push_back( PerfImageSize( 128,  64, true ) );
+	iSizes.push_back( PerfImageSize( 319, 240, true ) );
+
+
+	std::vector<PAIR_CONV>		iConvBGRA;
+	std::vector<PAIR_CONV>		iConvGRAY;
+	std::vector<PAIR_CONV>		iConvRGB565;
+	std::vector<PAIR_HALF>		iHalf;
+	std::vector<PAIR_HALF>		iHalfRef;	// bit-identical reference (or NULL)
+
+	std::vector<int>			iConvBGRA_Bpp;
+	std::vector<int>			iConvGRAY_Bpp;
+	std::vector<int>			iConvRGB565_Bpp;
+
+	iConvBGRA.push_back(MAKE_CONV_PAIR(ImageConvert::BGRA8888toGRAY8));		iConvBGRA_Bpp.push_back(1);
+	iConvBGRA.push_back(MAKE_CONV_PAIR(ImageConvert::BGRA8888toRGB565));	iConvBGRA_Bpp.push_back(2);
+	iConvBGRA.push_back(MAKE_CONV_PAIR(ImageConvert::BGRA8888toRGB888));	iConvBGRA_Bpp.push_back(3);
+	iConvBGRA.push_back(MAKE_CONV_PAIR(ImageConvert::BGRA8888toRGB565L));	iConvBGRA_Bpp.push_back(2);
+	iConvBGRA.push_back(MAKE_CONV_PAIR(ImageBlend::BGRA8888overBGRA8888_C));	iConvBGRA_Bpp.push_back(4);
+	iConvBGRA.push_back(MAKE_CONV_PAIR(ImageBlend::BGRA8888overBGRA8888));	iConvBGRA_Bpp.push_back(4);
+	iConvBGRA.push_back(MAKE_CONV_PAIR(ImageBlend::BGRA8888overRGB565_C));	iConvBGRA_Bpp.push_back(2);
+	iConvBGRA.push_back(MAKE_CONV_PAIR(ImageBlend::BGRA8888overRGB565));	iConvBGRA_Bpp.push_back(2);
+
+	iConvGRAY.push_back(MAKE_CONV_PAIR(ImageConvert::GRAY8toRGB565));		iConvGRAY_Bpp.push_back(2);
+	iConvGRAY.push_back(MAKE_CONV_PAIR(ImageConvert::GRAY8toRGB888));		iConvGRAY_Bpp.push_back(3);
+	iConvGRAY.push_back(MAKE_CONV_PAIR(ImageConvert::GRAY8toRGB565L));		iConvGRAY_Bpp.push_back(2);
+	iConvGRAY.push_back(MAKE_CONV_PAIR(A8overRGB565_Gray_C));				iConvGRAY_Bpp.push_back(2);
+	iConvGRAY.push_back(MAKE_CONV_PAIR(A8overRGB565_Gray));					iConvGRAY_Bpp.push_back(2);
+	iConvGRAY.push_back(MAKE_CONV_PAIR(A8overGRAY8_White_C));				iConvGRAY_Bpp.push_back(1);
+	iConvGRAY.push_back(MAKE_CONV_PAIR(A8overGRAY8_White));					iConvGRAY_Bpp.push_back(1);
+	iConvGRAY.push_back(MAKE_CONV_PAIR(A8overBGRA8888_White_C));			iConvGRAY_Bpp.push_back(4);
+	iConvGRAY.push_back(MAKE_CONV_PAIR(A8overBGRA8888_White));				iConvGRAY_Bpp.push_back(4);
+	iConvGRAY.push_back(MAKE_CONV_PAIR(ImageBitPack::GRAY8toPages_C));		iConvGRAY_Bpp.push_back(1);
+	iConvGRAY.push_back(MAKE_CONV_PAIR(ImageBitPack::GRAY8toPages));			iConvGRAY_Bpp.push_back(1);
+	iConvGRAY.push_back(MAKE_CONV_PAIR(ImageBitPack::GRAY8toPagesT_C));		iConvGRAY_Bpp.push_back(1);
+	iConvGRAY.push_back(MAKE_CONV_PAIR(ImageBitPack::GRAY8toPagesT));		iConvGRAY_Bpp.push_back(1);
+
+	iConvRGB565.push_back(MAKE_CONV_PAIR(ImageConvert::RGB565toRGB565L));	iConvRGB565_Bpp.push_back(2);
+	iConvRGB565.push_back(MAKE_CONV_PAIR(ImageConvert::RGB565toRGB888));	iConvRGB565_Bpp.push_back(3);
+	iConvRGB565.push_back(MAKE_CONV_PAIR(ImageConvert::RGB565toBGRA8888));	iConvRGB565_Bpp.push_back(4);
+
+	iHalf.push_back(MAKE_HALF_PAIR(ImageHalftoning::ErrDiff_FloydSteinberg));			iHalfRef.push_back(PAIR_HALF(NULL,NULL));
+	iHalf.push_back(MAKE_HALF_PAIR(ImageHalftoning::ErrDiffParallel_FloydSteinberg));	iHalfRef.push_back(MAKE_HALF_PAIR(ImageHalftoning::ErrDiff_FloydSteinberg));
+	iHalf.push_back(MAKE_HALF_PAIR(ImageHalftoning::ErrDiff_Burkes));					iHalfRef.push_back(PAIR_HALF(NULL,NULL));
+	iHalf.push_back(MAKE_HALF_PAIR(ImageHalftoning::ErrDiffParallel_Burkes));			iHalfRef.push_back(MAKE_HALF_PAIR(ImageHalftoning::ErrDiff_Burkes));
+	iHalf.push_back(MAKE_HALF_PAIR(ImageHalftoning::ErrDiff_Stucki));					iHalfRef.push_back(PAIR_HALF(NULL,NULL));
+	iHalf.push_back(MAKE_HALF_PAIR(ImageHalftoning::ErrDiffParallel_Stucki));			iHalfRef.push_back(MAKE_HALF_PAIR(ImageHalftoning::ErrDiff_Stucki));
+	iHalf.push_back(MAKE_HALF_PAIR(ImageHalftoning::ErrDiff_Atkinson));					iHalfRef.push_back(PAIR_HALF(NULL,NULL));
+	iHalf.push_back(MAKE_HALF_PAIR(ImageHalftoning::ErrDiffParallel_Atkinson));			iHalfRef.push_back(MAKE_HALF_PAIR(ImageHalftoning::ErrDiff_Atkinson));
+	iHalf.push_back(MAKE_HALF_PAIR(ImageHalftoning::ErrDiff_Sierra));					iHalfRef.push_back(PAIR_HALF(NULL,NULL));
+	iHalf.push_back(MAKE_HALF_PAIR(ImageHalftoning::ErrDiff_JarvisJudiceNinke));		iHalfRef.push_back(PAIR_HALF(NULL,NULL));
+	iHalf.push_back(MAKE_HALF_PAIR(ImageHalftoning::ErrDiff_LinearFloydSteinberg));		iHalfRef.push_back(PAIR_HALF(NULL,NULL));
+	iHalf.push_back(MAKE_HALF_PAIR(ImageHalftoning::ErrDiff_LinearStucki));				iHalfRef.push_back(PAIR_HALF(NULL,NULL));
+	iHalf.push_back(MAKE_HALF_PAIR(ImageHalftoning::PatternDither_2x2));				iHalfRef.push_back(PAIR_HALF(NULL,NULL));
+	iHalf.push_back(MAKE_HALF_PAIR(PatternDither_Bayer4));								iHalfRef.push_back(PAIR_HALF(NULL,NULL));
+	iHalf.push_back(MAKE_HALF_PAIR(OrderedDither_Bayer8));								iHalfRef.push_back(PAIR_HALF(NULL,NULL));
+	iHalf.push_back(MAKE_HALF_PAIR(OrderedDither_BlueNoise));							iHalfRef.push_back(PAIR_HALF(NULL,NULL));
+
+
+	std::vector<PerfResult>		iResults;
+	int							nResult	= 0;
+
+	if( 0 != FuzzConvert( 1000 ) )
+	{
+		printf( "ERROR: ImageConvert differs from the reference.\n" );
+		nResult	= -1;
+	}
+
+	if( 0 != FuzzBitPack( 10000 ) )
+	{
+		printf( "ERROR: ImageBitPack differs from the reference.\n" );
+		nResult	= -1;
+	}
+
+	if( 0 != FuzzBlendA8( 10000 ) )
+	{
+		printf( "ERROR: ImageBlend A8 blend differs from the reference.\n" );
+		nResult	= -1;
+	}
+
+	if( 0 != FuzzBlendBGRA( 10000 ) )
+	{
+		printf( "ERROR: ImageBlend BGRA blend differs from the reference.\n" );
+		nResult	= -1;
+	}
+
+	printf("| Function name                                  | Size      |Stride|   Throughput    |   Per pixel    |\n");
+	printf("|:-----------------------------------------------|:---------:|-----:|----------------:|---------------:|\n");
+
+	for( auto& size : iSizes )
+	{
+		// Converters from BGRA8888 / GRAY8 / RGB565
+		for( int s = 0; s < 3; s++ )
+		{
+			std::vector<PAIR_CONV>&	iConv	= 0 == s ? iConvBGRA : 1 == s ? iConvGRAY : iConvRGB565;
+			std::vector<int>&		iDstBpp	= 0 == s ? iConvBGRA_Bpp : 1 == s ? iConvGRAY_Bpp : iConvRGB565_Bpp;
+			int						nSrcBpp	= 0 == s ? 4 : 1 == s ? 1 : 2;
+
+			for( size_t i = 0; i < iConv.size(); i++ )
+			{
+				std::vector<uint8_t>	src;
+				std::vector<uint8_t>	dst;
+				int						nSrcStride	= size.GetStride( nSrcBpp );
+				int						nDstStride	= size.GetStride( iDstBpp[i] );
+				auto					func		= iConv[i].first;
+
+				FillTestImage( src, nSrcBpp, nSrcStride, size.width, size.height );
+				dst.assign( nDstStride * size.height + 4, 0 );
+
+				double	ns	= MeasureMedian(
+								nWarmup,
+								nSamples,
+								[](){},
+								[&]()
+								{
+									func( src.data(), nSrcStride, size.width, size.height, dst.data(), nDstStride );
+								} );
+
+				iResults.push_back( PerfResult( iConv[i].second, size, nSrcStride, ns ) );
+				ShowResult( iResults.back() );
+			}
+		}
+
+		// Halftoning (in-place, source is restored before every sample)
+		for( size_t i = 0; i < iHalf.size(); i++ )
+		{
+			std::vector<uint8_t>	src;
+			std::vector<uint8_t>	work;
+			int						nStride	= size.GetStride( 1 );
+			auto					func	= iHalf[i].first;
+
+			FillTestImage( src, 1, nStride, size.width, size.height );
+			work	= src;
+
+			double	ns	= MeasureMedian(
+							nWarmup,
+							nSamples,
+							[&]()
+							{
+								memcpy( work.data(), src.data(), src.size() );
+							},
+							[&]()
+							{
+								func( work.data(), nStride, size.width, size.height );
+							} );
+
+			iResults.push_back( PerfResult( iHalf[i].second, size, nStride, ns ) );
+			ShowResult( iResults.back() );
+
+			if( NULL != iHalfRef[i].first )
+			{
+				std::vector<uint8_t>	ref	= src;
+
+				iHalfRef[i].first( ref.data(), nStride, size.width, size.height );
+
+				if( ref != work )
+				{
+					printf( "ERROR: %s differs from %s\n", iHalf[i].second, iHalfRef[i].second );
+					nResult	= -1;
+				}
+			}
+		}
+	}
+
+	if( NULL != pszCsvPath )
+	{
+		FILE*	fp	= fopen( pszCsvPath, "w" );
+
+		if( NULL == fp )
+		{
+			printf( "ERROR: fopen(%s) failed.\n", pszCsvPath );
+			return	-1;
+		}
+
+		fprintf( fp, "label,function,width,height,stride,samples,median_ns,mpix_per_sec,ns_per_pixel\n" );
+
+		for( auto& result : iResults )
+		{
+			fprintf( fp, "%s,%s,%d,%d,%d,%d,%.0f,%.3f,%.3f\n",
+				pszLabel,
+				result.m_strName.c_str(),
+				result.m_nWidth,
+				result.m_nHeight,
+				result.m_nStride,
+				nSamples,
+				result.m_dMedianNs,
+				result.GetMpixPerSec(),
+				result.GetNsPerPixel() );
+		}
+
+		fclose( fp );
+	}
+
+	return	nResult;
+}
@@ -39,6 +39,7 @@
 #include "common/display_ili9341_spi.h"
 #include "common/display_ili9225_spi.h"
 //#include "common/display_ssd1306_i2c.h"
+//#include "common/display_ssd1306_spi.h"
 #include "common/display_ili9486_spi.h"
 #include "common/display_fbdev.h"
 
@@ -149,6 +150,8 @@ int main()
 
 //	display.push_back( new Display_SSD1306_i2c(180) );		// for SSD1306
 //	display.push_back( new Display_SSD1306_i2c(180,2) );	// for SH1106
+//	display.push_back( new Display_SSD1306_i2c(90) );		// for SSD1306, vertical mount (64x128)
+//	display.push_back( new Display_SSD1306_spi(180) );		// for SSD1306 4-wire SPI
 //	display.push_back( new Display_ILI9341_spi_TM24(0) );	// for Tianma2.4" Panel
 //	display.push_back( new Display_ILI9341_spi_TM22(0,199) );	// for Tianma2.2" Panel
 //	display.push_back( new Display_ILI9328_spi_TM22(0,200) );	// for Tianma2.2" Panel
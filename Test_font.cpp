@@ -0,0 +1,220 @@
+
+//	ImageFont / GlyphAtlas text path test.
+//
+//	g++ -O3 -std=c++11 Test_font.cpp -o Test_font.o `freetype-config --cflags` `freetype-config --libs` -pthread
+//
+//	./Test_font.o [font file]
+//
+//	Utf8Iterator is fuzzed against the original u32string decoder. Then the
+//	per-frame draw calls (CalcRect, DrawText* with UTF-8 strings, GlyphAtlas
+//	span / dirty / compose) are repeated after a warm-up while operator new
+//	is counted; the steady state must not allocate. Exit code -1 on failure.
+
+
+#include <vector>
+#include <string>
+#include <new>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "common/img_font.h"
+#include "common/img_glyph_atlas.h"
+
+
+static	size_t	g_nAllocs	= 0;
+
+void*	operator new( size_t size )
+{
+	g_nAllocs++;
+
+	if( void* p = malloc( size ? size : 1 ) )
+	{
+		return	p;
+	}
+
+	throw	std::bad_alloc();
+}
+
+void	operator delete( void* p ) noexcept
+{
+	free( p );
+}
+
+void	operator delete( void* p, size_t ) noexcept
+{
+	free( p );
+}
+
+
+// The decoder ImageFont used before Utf8Iterator.
+static	std::u32string	DecodeReference( const std::string& utf8 )
+{
+	std::u32string	u32str;
+
+	for( size_t i = 0; i < utf8.size(); i++ )
+	{
+		uint32_t	c	= (uint32_t)utf8[i];
+		int			n	= 0;
+
+		if( 0 == (0x80 & c) )
+		{
+			u32str.push_back( c );
+			continue;
+		}
+		else if( 0xC0 == (0xE0 & c) )
+		{
+			n	= 1;
+			c	= 0x1F & c;
+		}
+		else if( 0xE0 == (0xF0 & c) )
+		{
+			n	= 2;
+			c	= 0x0F & c;
+		}
+		else if( 0xF0 == (0xF8 & c) )
+		{
+			n	= 3;
+			c	= 0x07 & c;
+		}
+		else
+		{
+			continue;
+		}
+
+		if( (i + n) < utf8.size() )
+		{
+			for( int k = 1; k <= n; k++ )
+			{
+				c	= (c << 6) | (0x3F & utf8[i+k]);
+			}
+		}
+		else
+		{
+			c	= '?';
+		}
+
+		i	+= n;
+		u32str.push_back( c );
+	}
+
+	return	u32str;
+}
+
+
+static	int		FuzzUtf8( int nCount )
+{
+	uint32_t	seed	= 0x2545F491;
+	int			nFails	= 0;
+
+	auto	Rand	= [&]()
+	{
+		seed	= seed * 1103515245 + 12345;
+		return	(int)(seed >> 8);
+	};
+
+	for( int i = 0; i < nCount; i++ )
+	{
+		std::string		str;
+		int				len	= Rand() % 24;
+
+		for( int n = 0; n < len; n++ )
+		{
+			// mostly lead / continuation bytes, some ASCII.
+			static	const uint8_t	bytes[]	= { 'a', '0', 0x80, 0xBF, 0xC3, 0xA9, 0xE3, 0x81, 0x82, 0xF0, 0x9F, 0xF8, 0xFF };
+			uint8_t					b		= 0 == (Rand() & 3) ? (uint8_t)(1 + Rand() % 255) : bytes[ Rand() % sizeof(bytes) ];
+
+			str.push_back( (char)b );
+		}
+
+		std::u32string	ref	= DecodeReference( str );
+		std::u32string	out;
+		Utf8Iterator	it( str.c_str(), str.size() );
+		uint32_t		code;
+
+		while( it.Next( code ) )
+		{
+			out.push_back( code );
+		}
+
+		if( (out != ref) || (ImageFont::GetUnicode32fromUTF8( str.c_str() ) != ref) )
+		{
+			nFails++;
+		}
+	}
+
+	return	nFails;
+}
+
+
+int main( int argc, char* argv[] )
+{
+	const char*		pszFont		= 1 < argc ? argv[1] : "/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf";
+	int				nResult		= 0;
+
+	if( 0 != FuzzUtf8( 100000 ) )
+	{
+		printf( "ERROR: Utf8Iterator differs from the reference decoder.\n" );
+		nResult	= -1;
+	}
+
+	{
+		const int				cx		= 240;
+		const int				cy		= 32;
+		ImageFont				iFont( pszFont, cy );
+		GlyphAtlas				iAtlas;
+		std::vector<uint8_t>	gray( cx * cy );
+		std::vector<uint8_t>	bgra( cx * cy * 4 );
+		std::vector<uint8_t>	rgb565( cx * cy * 2 );
+		std::vector<uint8_t>	bits( (cx + 7) / 8 * cy );
+		const char*				pszTexts[]	= { "12:34", "12 35", "cpu 47.5 C", "2024/01/02", u8"Café あい", "-12.5 dB" };
+		size_t					nAllocs		= 0;
+
+		iAtlas.Create( iFont, "0123456789: ./-cpuCdB", 0, cy );
+
+		for( int pass = 0; pass < 2; pass++ )
+		{
+			size_t	nBase	= g_nAllocs;
+
+			for( int n = 0; n < 100; n++ )
+			{
+				for( size_t i = 0; i < sizeof(pszTexts) / sizeof(pszTexts[0]); i++ )
+				{
+					const char*	str		= pszTexts[i];
+					const char*	prev	= pszTexts[ 0 < i ? i - 1 : 0 ];
+					int			l, t, r, b;
+
+					iFont.CalcRect( l, t, r, b, str );
+					iFont.DrawTextGRAY( 0, 0, str, 255, gray.data(), cx, cx, cy );
+					iFont.DrawTextBGRA( 0, 0, str, 0xFFFFFFFF, bgra.data(), cx * 4, cx, cy );
+					iFont.DrawTextRGB565( 0, 0, str, 0xFFFFFFFF, rgb565.data(), cx * 2, cx, cy );
+					iFont.DrawText1BPP( 0, 0, str, 255, bits.data(), (cx + 7) / 8, cx, cy );
+
+					iAtlas.CalcSpan( str, l, r );
+					iAtlas.CalcDirty( 0, prev, 0, str, l, r );
+					iAtlas.ComposeGRAY( 0, str, 255, gray.data(), cx, cx );
+					iAtlas.ComposeBGRA( 0, str, 0xFFFFFFFF, bgra.data(), cx * 4, cx );
+				}
+			}
+
+			// pass 0 is the warm-up. (glyph cache, atlas cells, runs)
+			nAllocs	= g_nAllocs - nBase;
+		}
+
+		printf( "steady state allocations: %zu\n", nAllocs );
+
+		if( 0 != nAllocs )
+		{
+			printf( "ERROR: the steady state text draw path allocates.\n" );
+			nResult	= -1;
+		}
+	}
+
+	if( 0 == nResult )
+	{
+		printf( "OK\n" );
+	}
+
+	return	nResult;
+}
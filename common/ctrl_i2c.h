@@ -7,8 +7,15 @@
 
 #include <fcntl.h>
 #include <sys/ioctl.h>
+#include <linux/i2c.h>
 #include <linux/i2c-dev.h>
 
+#include <vector>
+
+#ifndef I2C_RDWR_IOCTL_MAX_MSGS
+#define I2C_RDWR_IOCTL_MAX_MSGS     42
+#endif
+
 
 class ctrl_i2c
 {
@@ -17,6 +24,9 @@ public:
     {
         int     ret;
 
+        m_nAddr     = addr;
+        m_nSyscalls = 0;
+
         m_i2c    = ::open( dev, O_RDWR );
         if( m_i2c < 0 )
         {
@@ -35,6 +45,8 @@ public:
     bool    write( const unsigned char * data, int size )
     {
         int wrote   = ::write( m_i2c, data, size );
+
+        m_nSyscalls++;
         
         if( size != wrote )
         {
@@ -49,6 +61,8 @@ public:
     bool    read( unsigned char * data, int size )
     {
         int read   = ::read( m_i2c, data, size );
+
+        m_nSyscalls++;
         
         if( size != read )
         { 
@@ -59,8 +73,175 @@ public:
         return  true;    
     }
 
+    // I2C_RDWR: messages are sent with repeated START and one STOP at the end.
+    // More than I2C_RDWR_IOCTL_MAX_MSGS messages are split into several ioctls.
+    bool    transfer( struct i2c_msg * msgs, int count )
+    {
+        while( 0 < count )
+        {
+            struct i2c_rdwr_ioctl_data  iData;
+            int                         n   = I2C_RDWR_IOCTL_MAX_MSGS < count ? I2C_RDWR_IOCTL_MAX_MSGS : count;
+            int                         ret;
+
+            iData.msgs  = msgs;
+            iData.nmsgs = n;
+
+            ret     = ::ioctl( m_i2c, I2C_RDWR, &iData );
+
+            m_nSyscalls++;
+
+            if( ret != n )
+            {
+                printf("ERROR! ctrl_i2c.transfer( *, %d ) ret %d\n", n, ret );
+                return  false;
+            }
+
+            msgs    += n;
+            count   -= n;
+        }
+
+        return  true;
+    }
+
+    // Register read: write (register address) + repeated START + read, in one syscall.
+    bool    write_read( const unsigned char * wdata, int wsize, unsigned char * rdata, int rsize )
+    {
+        struct i2c_msg  msgs[2];
+
+        msgs[0].addr    = m_nAddr;
+        msgs[0].flags   = 0;
+        msgs[0].len     = wsize;
+        msgs[0].buf     = (unsigned char*)wdata;
+
+        msgs[1].addr    = m_nAddr;
+        msgs[1].flags   = I2C_M_RD;
+        msgs[1].len     = rsize;
+        msgs[1].buf     = rdata;
+
+        return  transfer( msgs, 2 );
+    }
+
+    // Number of write/read/ioctl calls since construction (or ResetSyscallCount).
+    int     GetSyscallCount() const
+    {
+        return  m_nSyscalls;
+    }
+
+    void    ResetSyscallCount()
+    {
+        m_nSyscalls = 0;
+    }
+
+    // Queues messages (data is copied) and sends them with one transfer().
+    //
+    //  ctrl_i2c::Batch     iBatch( iic );
+    //  iBatch.write( reg1, 2 );
+    //  iBatch.write( 0x11, reg2, 2 );      // other slave on the same bus
+    //  iBatch.commit();
+    class Batch
+    {
+    public:
+        Batch( ctrl_i2c& i2c ) : m_i2c( i2c )
+        {
+        }
+
+        Batch&  write( const unsigned char * data, int size )
+        {
+            return  write( m_i2c.m_nAddr, data, size );
+        }
+
+        Batch&  write( int addr, const unsigned char * data, int size )
+        {
+            Add( addr, 0, size );
+            m_iData.insert( m_iData.end(), data, data + size );
+            return  *this;
+        }
+
+        // register write, { reg, value }
+        Batch&  write_reg( int addr, unsigned char reg, unsigned char value )
+        {
+            unsigned char   data[2] = { reg, value };
+
+            return  write( addr, data, 2 );
+        }
+
+        // data is filled by commit().
+        Batch&  read( int addr, unsigned char * data, int size )
+        {
+            Add( addr, I2C_M_RD, size );
+            m_iData.resize( m_iData.size() + size );
+            m_iReadTo.push_back( data );
+            return  *this;
+        }
+
+        bool    empty() const
+        {
+            return  m_iMsgs.empty();
+        }
+
+        bool    commit()
+        {
+            bool    ret     = true;
+            size_t  offset  = 0;
+            size_t  nRead   = 0;
+
+            if( m_iMsgs.empty() )
+            {
+                return  true;
+            }
+
+            for( auto& msg : m_iMsgs )
+            {
+                msg.buf = &m_iData[ offset ];
+                offset  += msg.len;
+            }
+
+            ret     = m_i2c.transfer( m_iMsgs.data(), (int)m_iMsgs.size() );
+
+            for( auto& msg : m_iMsgs )
+            {
+                if( I2C_M_RD & msg.flags )
+                {
+                    for( int i = 0; i < msg.len; i++ )
+                    {
+                        m_iReadTo[ nRead ][i]   = msg.buf[i];
+                    }
+
+                    nRead++;
+                }
+            }
+
+            m_iMsgs.clear();
+            m_iData.clear();
+            m_iReadTo.clear();
+
+            return  ret;
+        }
+
+    protected:
+        void    Add( int addr, int flags, int size )
+        {
+            struct i2c_msg  msg;
+
+            msg.addr    = addr;
+            msg.flags   = flags;
+            msg.len     = size;
+            msg.buf     = NULL;
+
+            m_iMsgs.push_back( msg );
+        }
+
+    protected:
+        ctrl_i2c&                       m_i2c;
+        std::vector<struct i2c_msg>     m_iMsgs;
+        std::vector<unsigned char>      m_iData;
+        std::vector<unsigned char*>     m_iReadTo;
+    };
+
 private:
     int     m_i2c;
+    int     m_nAddr;
+    int     m_nSyscalls;
 };
 
 #endif
@@ -0,0 +1,704 @@
+#ifndef	__CTRL_MPD_H_INCLUDED__
+#define	__CTRL_MPD_H_INCLUDED__
+
+//	MPD protocol client.
+//
+//	MpdConnection:	one connection with a buffered response reader. A
+//					response is read up to its "OK" / "ACK" line however MPD
+//					splits it into packets, into a receive buffer that is
+//					reused by the next response. SendList() batches commands
+//					in a command_list_ok_begin, so they take one round trip.
+//
+//	MpdStatus:		the currentsong / status fields the UI uses, by field id.
+//					Parse() reads a response in place and Update() copies
+//					another status; both return a mask of the fields that
+//					changed, so consumers skip work for the others. Values
+//					keep their string capacity, no allocation once warm.
+//
+//	MpdClient:		persistent connection with change notification.
+//					A thread keeps one connection to MPD. It reads currentsong
+//					and status, publishes them, then waits in "idle player
+//					mixer options playlist" until MPD reports a change, and
+//					reads them again. The UI takes the latest status with
+//					GetStatus() instead of connecting and querying every frame.
+//
+//	MPD does not notify the playing position, so while playing GetStatus()
+//	advances "elapsed" by the time since status was read.
+//
+//	A lost connection is retried with a backoff of BACKOFF_MIN_MS doubling
+//	up to BACKOFF_MAX_MS; meanwhile GetStatus() returns an empty status.
+//	The backoff is reset only by a connection that delivered a status, so
+//	an MPD that accepts and then ACKs or drops every command is not
+//	reconnected at BACKOFF_MIN_MS forever.
+//	ThreadStop() ends the idle with "noidle".
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include "ctrl_socket.h"
+
+class MpdConnection
+{
+public:
+	enum
+	{
+		TIMEOUT_MS		= 3000,		// command responses
+		BUFFER_SIZE		= 16384,	// initial receive buffer, grows for longer responses
+	};
+
+public:
+	MpdConnection()
+	{
+		m_iBuf.resize( BUFFER_SIZE );
+		m_isConnected	= false;
+		m_nBegin		= 0;
+		m_nEnd			= 0;
+	}
+
+	// Connect and read the "OK MPD <version>" banner.
+	bool	Connect( const char* pszHostName, int port )
+	{
+		Close();
+
+		m_pSock.reset( new Socket() );
+
+		if( 0 != m_pSock->connect( pszHostName, port ) )
+		{
+			Close();
+			return	false;
+		}
+
+		m_pSock->SetTimeout( TIMEOUT_MS );
+		m_isConnected	= true;
+
+		size_t	pos;
+		size_t	end;
+
+		if( !NextLine( pos, end ) || (0 != strncmp( &m_iBuf[ pos ], "OK MPD ", 7 )) )
+		{
+			Close();
+			return	false;
+		}
+
+		m_nBegin	= end + 1;
+		return	true;
+	}
+
+	void	Close()
+	{
+		m_pSock.reset();
+		m_isConnected	= false;
+		m_nBegin		= 0;
+		m_nEnd			= 0;
+	}
+
+	bool	IsConnected() const
+	{
+		return	m_isConnected;
+	}
+
+	// 0: no timeout. (idle)
+	void	SetTimeout( int timeout )
+	{
+		if( IsConnected() )
+		{
+			m_pSock->SetTimeout( timeout );
+		}
+	}
+
+	// cmd without the newline.
+	bool	Send( const char* cmd )
+	{
+		m_strSend	= cmd;
+		m_strSend	+= '\n';
+
+		return	SendBuffer();
+	}
+
+	// cmds as one command list. The response has a "list_OK" line after each.
+	bool	SendList( const char* const* cmds, int count )
+	{
+		m_strSend	= "command_list_ok_begin\n";
+
+		for( int i = 0; i < count; i++ )
+		{
+			m_strSend	+= cmds[ i ];
+			m_strSend	+= '\n';
+		}
+
+		m_strSend	+= "command_list_end\n";
+
+		return	SendBuffer();
+	}
+
+	// End a pending idle from another thread. The socket stays until Close(),
+	// also when the idle read fails.
+	void	NoIdle()
+	{
+		m_pSock->send( (const uint8_t*)"noidle\n", 7 );
+	}
+
+	// The lines before "OK", valid until the next read. false: ACK (data = the
+	// ACK line) or the connection was lost. (IsConnected)
+	bool	ReadResponse( const char*& data, size_t& len )
+	{
+		// drop the previous response, keep what was received after it.
+		if( 0 < m_nBegin )
+		{
+			memmove( &m_iBuf[ 0 ], &m_iBuf[ m_nBegin ], m_nEnd - m_nBegin );
+			m_nEnd		-= m_nBegin;
+			m_nBegin	= 0;
+		}
+
+		size_t	pos;
+		size_t	end;
+
+		data	= NULL;
+		len		= 0;
+
+		while( NextLine( pos, end ) )
+		{
+			m_nBegin	= end + 1;
+
+			if( (2 == (end - pos)) && (0 == memcmp( &m_iBuf[ pos ], "OK", 2 )) )
+			{
+				data	= &m_iBuf[ 0 ];
+				len		= pos;
+				return	true;
+			}
+
+			if( 0 == strncmp( &m_iBuf[ pos ], "ACK ", 4 ) )
+			{
+				data	= &m_iBuf[ pos ];
+				len		= end - pos;
+				printf( "WARNING: MpdConnection %.*s\n", (int)len, data );
+				return	false;
+			}
+		}
+
+		return	false;
+	}
+
+	bool	Command( const char* cmd, const char*& data, size_t& len )
+	{
+		return	Send( cmd ) && ReadResponse( data, len );
+	}
+
+	bool	Command( const char* cmd )
+	{
+		const char*	data;
+		size_t		len;
+
+		return	Command( cmd, data, len );
+	}
+
+protected:
+	bool	SendBuffer()
+	{
+		if( !IsConnected() || ((int)m_strSend.size() != m_pSock->send( (const uint8_t*)m_strSend.data(), m_strSend.size() )) )
+		{
+			m_isConnected	= false;
+			return	false;
+		}
+
+		return	true;
+	}
+
+	// Next complete line from m_nBegin, [pos,end) without the newline.
+	bool	NextLine( size_t& pos, size_t& end )
+	{
+		size_t	scan	= m_nBegin;
+
+		pos		= m_nBegin;
+
+		while( IsConnected() )
+		{
+			const char*	nl	= (const char*)memchr( m_iBuf.data() + scan, '\n', m_nEnd - scan );
+
+			if( NULL != nl )
+			{
+				end		= nl - m_iBuf.data();
+				return	true;
+			}
+
+			scan	= m_nEnd;
+
+			if( m_nEnd == m_iBuf.size() )
+			{
+				m_iBuf.resize( m_iBuf.size() * 2 );
+			}
+
+			int		ret	= m_pSock->recv( (uint8_t*)m_iBuf.data() + m_nEnd, m_iBuf.size() - m_nEnd );
+
+			if( ret <= 0 )
+			{
+				m_isConnected	= false;
+				return	false;
+			}
+
+			m_nEnd	+= ret;
+		}
+
+		return	false;
+	}
+
+protected:
+	std::unique_ptr<Socket>		m_pSock;
+	bool						m_isConnected;
+	std::vector<char>			m_iBuf;		// [m_nBegin,m_nEnd) received, not yet read
+	size_t						m_nBegin;
+	size_t						m_nEnd;
+	std::string					m_strSend;
+};
+
+
+
+class MpdStatus
+{
+public:
+	enum FIELD
+	{
+		FIELD_FILE		= 0,
+		FIELD_TITLE,
+		FIELD_ARTIST,
+		FIELD_ALBUM,
+		FIELD_ALBUMARTIST,
+		FIELD_NAME,
+		FIELD_DATE,
+		FIELD_GENRE,
+		FIELD_TRACK,
+		FIELD_TIME,				// currentsong, seconds
+		FIELD_STATE,
+		FIELD_VOLUME,
+		FIELD_ELAPSED,
+		FIELD_DURATION,
+		FIELD_AUDIO,
+		FIELD_BITRATE,
+		FIELD_REPEAT,
+		FIELD_RANDOM,
+		FIELD_SINGLE,
+		FIELD_CONSUME,
+		FIELD_COUNT,
+	};
+
+	typedef	uint32_t	Mask;	// bit per FIELD
+
+	enum : Mask
+	{
+		ALL		= (1u << FIELD_COUNT) - 1,
+	};
+
+public:
+	static	Mask	Bit( int field )
+	{
+		return	(Mask)1 << field;
+	}
+
+	// Field id of an MPD key (case sensitive, as MPD sends it), -1 if not used.
+	// Runs for every line of every response: the first character, then the
+	// length or the second character pick the only candidate, one compare.
+	static	int		GetFieldId( const char* key, size_t len )
+	{
+		int		field	= -1;
+
+		if( len < 4 )
+		{
+			return	-1;
+		}
+
+		switch( key[0] )
+		{
+		case 'f':	field	= FIELD_FILE;																break;
+		case 'T':	field	= 4 == len ? FIELD_TIME : ('i' == key[1] ? FIELD_TITLE : FIELD_TRACK);		break;
+		case 'A':	field	= 5 == len ? FIELD_ALBUM : (6 == len ? FIELD_ARTIST : FIELD_ALBUMARTIST);	break;
+		case 'N':	field	= FIELD_NAME;																break;
+		case 'D':	field	= FIELD_DATE;																break;
+		case 'G':	field	= FIELD_GENRE;																break;
+		case 's':	field	= 5 == len ? FIELD_STATE : FIELD_SINGLE;									break;
+		case 'v':	field	= FIELD_VOLUME;																break;
+		case 'e':	field	= FIELD_ELAPSED;															break;
+		case 'd':	field	= FIELD_DURATION;															break;
+		case 'a':	field	= FIELD_AUDIO;																break;
+		case 'b':	field	= FIELD_BITRATE;															break;
+		case 'r':	field	= 'e' == key[1] ? FIELD_REPEAT : FIELD_RANDOM;								break;
+		case 'c':	field	= FIELD_CONSUME;															break;
+		default:	return	-1;
+		}
+
+		const char*	name	= GetFieldName( field );
+
+		return	(0 == strncmp( name, key, len )) && ('\0' == name[ len ]) ? field : -1;
+	}
+
+	static	int		GetFieldId( const char* key )
+	{
+		return	GetFieldId( key, strlen( key ) );
+	}
+
+	static	const char*	GetFieldName( int field )
+	{
+		static	const char*	names[ FIELD_COUNT ]	=
+		{
+			"file", "Title", "Artist", "Album", "AlbumArtist", "Name", "Date", "Genre", "Track", "Time",
+			"state", "volume", "elapsed", "duration", "audio", "bitrate", "repeat", "random", "single", "consume",
+		};
+
+		return	names[ field ];
+	}
+
+	// "" if not in the last response.
+	const std::string&	Get( int field ) const
+	{
+		return	m_strValues[ field ];
+	}
+
+	bool	Has( int field ) const
+	{
+		return	!m_strValues[ field ].empty();
+	}
+
+	float	GetFloat( int field, float def = 0 ) const
+	{
+		return	Has( field ) ? (float)atof( m_strValues[ field ].c_str() ) : def;
+	}
+
+	// Bit( field ) if the value changed, else 0.
+	Mask	Set( int field, const char* value, size_t len )
+	{
+		std::string&	str	= m_strValues[ field ];
+
+		if( (str.size() == len) && (0 == memcmp( str.data(), value, len )) )
+		{
+			return	0;
+		}
+
+		str.assign( value, len );
+		return	Bit( field );
+	}
+
+	Mask	Set( int field, const std::string& value )
+	{
+		return	Set( field, value.data(), value.size() );
+	}
+
+	// "key: value" lines of a response, ("list_OK" lines have no value)
+	// fields it does not have become empty.
+	Mask	Parse( const char* data, size_t len )
+	{
+		const char*		values[ FIELD_COUNT ]	= { NULL };
+		size_t			lengths[ FIELD_COUNT ]	= { 0 };
+		const char*		end						= data + len;
+		Mask			changed					= 0;
+
+		while( data < end )
+		{
+			const char*	eol		= (const char*)memchr( data, '\n', end - data );
+			const char*	sep		= (const char*)memchr( data, ':', (NULL != eol ? eol : end) - data );
+
+			eol		= NULL != eol ? eol : end;
+
+			if( (NULL != sep) && ((sep + 1) < eol) && (' ' == sep[1]) )
+			{
+				int		field	= GetFieldId( data, sep - data );
+
+				if( 0 <= field )
+				{
+					values[ field ]		= sep + 2;
+					lengths[ field ]	= eol - (sep + 2);
+				}
+			}
+
+			data	= eol + 1;
+		}
+
+		for( int i = 0; i < FIELD_COUNT; i++ )
+		{
+			changed	|= Set( i, NULL != values[ i ] ? values[ i ] : "", lengths[ i ] );
+		}
+
+		return	changed;
+	}
+
+	// Copy status, returns the fields that differed.
+	Mask	Update( const MpdStatus& status )
+	{
+		Mask	changed	= 0;
+
+		for( int i = 0; i < FIELD_COUNT; i++ )
+		{
+			changed	|= Set( i, status.m_strValues[ i ] );
+		}
+
+		return	changed;
+	}
+
+protected:
+	std::string		m_strValues[ FIELD_COUNT ];
+};
+
+
+
+class MpdClient
+{
+public:
+	enum
+	{
+		BACKOFF_MIN_MS	= 100,
+		BACKOFF_MAX_MS	= 5000,
+	};
+
+public:
+	MpdClient()
+	{
+		m_nPort			= 0;
+		m_isExecuting	= false;
+		m_isIdle		= false;
+		m_nVersion		= 1;
+		m_isPlaying		= false;
+		m_fElapsed		= 0;
+		m_fDuration		= 0;
+	}
+
+	~MpdClient()
+	{
+		ThreadStop();
+	}
+
+	bool	ThreadStart( const char* pszHostName, int port )
+	{
+		ThreadStop();
+
+		m_strHost		= pszHostName;
+		m_nPort			= port;
+		m_isExecuting	= true;
+		m_iThread		= std::thread( ThreadProc, this );
+
+		return	true;
+	}
+
+	void	ThreadStop()
+	{
+		if( !m_iThread.joinable() )
+		{
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex>	lock( m_iMutex );
+
+			m_isExecuting	= false;
+
+			if( m_isIdle )
+			{
+				m_iConn.NoIdle();
+			}
+		}
+
+		m_iCond.notify_all();
+		m_iThread.join();
+	}
+
+	// Called on the client thread with each status read from MPD, before it
+	// is published, to fill in fields derived from the others. Set before
+	// ThreadStart().
+	void	SetDerive( std::function<void(MpdStatus&)> func )
+	{
+		m_fnDerive	= func;
+	}
+
+	// Update status to the latest currentsong + status if they changed since
+	// nVersion (start with 0). FIELD_ELAPSED is advanced on every call while
+	// playing. Returns the fields that changed in status.
+	MpdStatus::Mask	GetStatus( MpdStatus& status, uint64_t& nVersion )
+	{
+		std::lock_guard<std::mutex>	lock( m_iMutex );
+
+		MpdStatus::Mask	changed	= 0;
+
+		if( nVersion != m_nVersion )
+		{
+			changed		= status.Update( m_iStatus );
+			nVersion	= m_nVersion;
+		}
+
+		if( m_isPlaying )
+		{
+			double	elapsed	= m_fElapsed + std::chrono::duration<double>( std::chrono::steady_clock::now() - m_tUpdated ).count();
+			char	szBuf[32];
+
+			if( (0 < m_fDuration) && (m_fDuration < elapsed) )
+			{
+				elapsed	= m_fDuration;
+			}
+
+			int		len		= sprintf( szBuf, "%.3f", elapsed );
+
+			changed	|= status.Set( MpdStatus::FIELD_ELAPSED, szBuf, len );
+		}
+
+		return	changed;
+	}
+
+	// Wait up to timeout ms for a status newer than nVersion. false on timeout.
+	bool	WaitChange( uint64_t nVersion, int timeout )
+	{
+		std::unique_lock<std::mutex>	lock( m_iMutex );
+
+		return	m_iCond.wait_for( lock, std::chrono::milliseconds( timeout ), [&]{ return nVersion != m_nVersion; } );
+	}
+
+protected:
+	static	void	ThreadProc( MpdClient* piThis )
+	{
+		int		backoff	= BACKOFF_MIN_MS;
+
+		while( piThis->IsExecuting() )
+		{
+			if( piThis->Session() )
+			{
+				backoff	= BACKOFF_MIN_MS;
+			}
+
+			piThis->Publish( NULL, 0 );
+
+			std::unique_lock<std::mutex>	lock( piThis->m_iMutex );
+
+			piThis->m_iCond.wait_for( lock, std::chrono::milliseconds( backoff ), [&]{ return !piThis->m_isExecuting; } );
+			backoff	= backoff * 2 < BACKOFF_MAX_MS ? backoff * 2 : BACKOFF_MAX_MS;
+		}
+	}
+
+	bool	IsExecuting()
+	{
+		std::lock_guard<std::mutex>	lock( m_iMutex );
+
+		return	m_isExecuting;
+	}
+
+	// One connection, until it is lost or stopped. false: no status was
+	// read (refused, ACK to every command, ...), the backoff keeps growing.
+	bool	Session()
+	{
+		// one round trip for both.
+		static	const char*	cmds[]	= { "currentsong", "status" };
+
+		const char*	data;
+		size_t		len;
+		bool		isPublished	= false;
+
+		if( !m_iConn.Connect( m_strHost.c_str(), m_nPort ) )
+		{
+			return	false;
+		}
+
+		while( true )
+		{
+			if( !m_iConn.SendList( cmds, 2 ) || !m_iConn.ReadResponse( data, len ) )
+			{
+				break;
+			}
+
+			Publish( data, len );
+			isPublished	= true;
+
+			{
+				std::lock_guard<std::mutex>	lock( m_iMutex );
+
+				if( !m_isExecuting )
+				{
+					break;
+				}
+
+				// blocks until something changes, no timeout.
+				m_iConn.SetTimeout( 0 );
+
+				if( !m_iConn.Send( "idle player mixer options playlist" ) )
+				{
+					break;
+				}
+
+				m_isIdle	= true;
+			}
+
+			bool	isRead	= m_iConn.ReadResponse( data, len );
+
+			{
+				std::lock_guard<std::mutex>	lock( m_iMutex );
+
+				m_isIdle	= false;
+			}
+
+			m_iConn.SetTimeout( MpdConnection::TIMEOUT_MS );
+
+			if( !isRead || !IsExecuting() )
+			{
+				break;
+			}
+		}
+
+		m_iConn.Close();
+		return	isPublished;
+	}
+
+	// The response becomes the status, empty = disconnected. The version
+	// only changes if a field did.
+	void	Publish( const char* data, size_t len )
+	{
+		m_iParsed.Parse( data, len );
+
+		if( m_fnDerive )
+		{
+			m_fnDerive( m_iParsed );
+		}
+
+		{
+			std::lock_guard<std::mutex>	lock( m_iMutex );
+
+			// elapsed is re-read on each change, its time too.
+			m_isPlaying	= "play" == m_iParsed.Get( MpdStatus::FIELD_STATE );
+			m_fElapsed	= m_iParsed.GetFloat( MpdStatus::FIELD_ELAPSED );
+			m_fDuration	= m_iParsed.GetFloat( MpdStatus::FIELD_DURATION );
+			m_tUpdated	= std::chrono::steady_clock::now();
+
+			if( 0 == m_iStatus.Update( m_iParsed ) )
+			{
+				return;
+			}
+
+			m_nVersion++;
+		}
+
+		m_iCond.notify_all();
+	}
+
+protected:
+	std::string								m_strHost;
+	int										m_nPort;
+	std::thread								m_iThread;
+	MpdConnection							m_iConn;
+	MpdStatus								m_iParsed;		// client thread
+	std::function<void(MpdStatus&)>			m_fnDerive;
+	std::mutex								m_iMutex;
+	std::condition_variable					m_iCond;		// m_nVersion, m_isExecuting
+
+	// under m_iMutex
+	bool									m_isExecuting;
+	bool									m_isIdle;		// m_iConn may be sent "noidle"
+	uint64_t								m_nVersion;
+	MpdStatus								m_iStatus;
+	bool									m_isPlaying;
+	double									m_fElapsed;		// status "elapsed" at m_tUpdated
+	double									m_fDuration;
+	std::chrono::steady_clock::time_point	m_tUpdated;
+};
+
+#endif	// __CTRL_MPD_H_INCLUDED__
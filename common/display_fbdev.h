@@ -202,6 +202,27 @@ public:
 		
 		return	-1;
 	}
+
+	virtual	int WriteImageRGB565( int x, int y, const uint8_t* image, int stride, int cx, int cy )
+	{
+		if( (m_pFrameBuffer != NULL) && _CalcTransArea( x, y, image, stride, 2, cx, cy ) )
+		{
+			uint8_t	*	dst	= m_pFrameBuffer + m_tFixScreenInfo.line_length * y + x * (m_tVarScreenInfo.bits_per_pixel >> 3);
+			
+			switch( m_tVarScreenInfo.bits_per_pixel )
+			{
+			case 32:
+				ImageConvert::RGB565toBGRA8888( image, stride, cx, cy, dst, m_tFixScreenInfo.line_length );
+				return	0;
+				
+			case 16:
+				ImageConvert::RGB565toRGB565L( image, stride, cx, cy, dst, m_tFixScreenInfo.line_length );
+				return	0;
+			}
+		}
+		
+		return	-1;
+	}
 	
 	virtual	void	Flush()
 	{
@@ -3,6 +3,9 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <vector>
+#include "img_conv.h"
+#include "img_bitpack.h"
 
 
 class DisplayIF
@@ -40,6 +43,31 @@ public:
 
 	virtual	int WriteImageBGRA( int x, int y, const uint8_t* image, int stride, int cx, int cy )=0;
 	virtual	int WriteImageGRAY( int x, int y, const uint8_t* image, int stride, int cx, int cy )=0;
+
+	// RGB565, MSB first. (ImageConvert::BGRA8888toRGB565)
+	// Default: converted to BGRA, displays with a RGB565 bus override it.
+	virtual	int WriteImageRGB565( int x, int y, const uint8_t* image, int stride, int cx, int cy )
+	{
+		std::vector<uint8_t>	bgra( cx * cy * 4 );
+
+		ImageConvert::RGB565toBGRA8888( image, stride, cx, cy, bgra.data(), cx * 4 );
+
+		return	WriteImageBGRA( x, y, bgra.data(), cx * 4, cx, cy );
+	}
+
+	// 1bpp, (cx + 7) / 8 bytes per row, bit n = pixel n. (ImageBitPack::GRAY8toBits)
+	// Default: expanded to GRAY, mono displays override it.
+	virtual	int WriteImage1BPP( int x, int y, const uint8_t* image, int stride, int cx, int cy )
+	{
+		std::vector<uint8_t>	gray( cx * cy );
+
+		for( int r = 0; r < cy; r++ )
+		{
+			ImageBitPack::BitsToGRAY8( image + stride * r, 0, cx, &gray[ cx * r ] );
+		}
+
+		return	WriteImageGRAY( x, y, gray.data(), cx, cx, cy );
+	}
 	
 	virtual	void Flush()
 	{
@@ -96,6 +124,22 @@ protected:
 		return  true;
 	}
 
+	// _CalcTransArea() for 1bpp rows. The left clip can not move image by
+	// whole bytes, it is returned as the first bit of the rows. (bit_x)
+	bool    _CalcTransArea1BPP( int& x, int& y, const uint8_t* & image, int stride, int& bit_x, int& cx, int& cy )
+	{
+		bit_x	= 0;
+
+		if( x < 0 )
+		{
+			bit_x	= -x;
+			cx		+= x;
+			x		= 0;
+		}
+
+		return	_CalcTransArea( x, y, image, stride, 1, cx, cy );
+	}
+
 
 protected:
 	DispSize     m_tDispSize;
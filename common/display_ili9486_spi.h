@@ -73,6 +73,18 @@ public:
 		
 		return	-1;
 	}
+
+	virtual	int WriteImageRGB565( int x, int y, const uint8_t* image, int stride, int cx, int cy )
+	{
+		if( _CalcTransArea( x, y, image, stride, 2, cx, cy ) )
+		{
+			ImageConvert::RGB565toRGB888( image, stride, cx, cy, m_iFrameBuf.data(), cx * 3 );
+
+			return	TransferRGB( x, y, cx, cy, m_iFrameBuf.data(), cx * cy * 3  );
+		}
+		
+		return	-1;
+	}
 };
 
 
@@ -162,6 +162,27 @@ public:
 		
 		return	-1;
 	}
+
+	// Panel format already, sent as is when the rows are contiguous.
+	virtual	int WriteImageRGB565( int x, int y, const uint8_t* image, int stride, int cx, int cy )
+	{
+		if( _CalcTransArea( x, y, image, stride, 2, cx, cy ) )
+		{
+			if( stride == (cx * 2) )
+			{
+				return	TransferRGB( x, y, cx, cy, image, cx * cy * 2 );
+			}
+
+			for( int r = 0; r < cy; r++ )
+			{
+				memcpy( &m_iFrameBuf[ cx * 2 * r ], image + stride * r, cx * 2 );
+			}
+
+			return	TransferRGB( x, y, cx, cy, m_iFrameBuf.data(), cx * cy * 2 );
+		}
+
+		return	-1;
+	}
 	
 	virtual	int GetBPP()
 	{
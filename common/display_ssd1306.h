@@ -0,0 +1,505 @@
+#ifndef	__DISPLAY_SSD1306_H_INCLUDED__
+#define	__DISPLAY_SSD1306_H_INCLUDED__
+
+#include <string.h>
+#include "display_if.h"
+#include "img_conv.h"
+#include "img_halftone.h"
+#include "img_bitpack.h"
+
+//	128x64 mono OLED (SSD1306 / SH1106) frame buffer logic.
+//	Page store, dirty tracking and init sequence are shared, the bus is
+//	supplied by the derived class. (Display_SSD1306_i2c / Display_SSD1306_spi)
+class Display_SSD1306 : public DisplayIF
+{
+public:
+	// nWindowOverhead: bus cost of one extra window, in data bytes.
+	Display_SSD1306( int nRotate, int x_offset, int nWindowOverhead )
+	{
+		m_nRotate	= nRotate;
+		m_nXoffset	= x_offset;
+		m_nWindowOverhead	= nWindowOverhead;
+		m_pHalftone	= NULL;
+
+		// SH1106 (132 column RAM) has no horizontal addressing mode.
+		m_isPageMode	= 0 != x_offset;
+
+		// 90/270: 64x128 logical, rows are written as page columns.
+		m_isTransposed	= (90 == nRotate) || (270 == nRotate);
+
+		memset( m_iPageBuf, 0, sizeof(m_iPageBuf) );
+		memset( m_iShadow, 0, sizeof(m_iShadow) );
+		ResetDirty();
+		
+		switch( nRotate )
+		{
+		case 0:		break;
+		case 90:	break;
+		case 180:	break;
+		case 270:	break;
+
+		default:
+			printf( "ERROR: Display_SSD1306() Invalid rotate %d.\n", nRotate );
+			throw	"Display_SSD1306() INVALID rotate";
+		}
+	}
+
+	virtual int Init()
+	{
+		printf( "Display_SSD1306::Init()\n");
+		
+		///////////////////////////////////////////////////////
+		// 1. Fundamental Command Table
+		///////////////////////////////////////////////////////
+
+		// Set Contrast Control
+//		WriteCmd(0x81);
+//		WriteCmd(0xFF);
+
+		// Normal display (RESET)
+		WriteCmd(0xA6);
+
+		///////////////////////////////////////////////////////
+		// 3. Addressing Setting Command Table
+		///////////////////////////////////////////////////////
+
+		// Set Memory Addressing Mode
+		WriteCmd(0x20);
+		WriteCmd( m_isPageMode ? 0x02 : 0x00 );	// Page Addressing Mode (RESET) / Horizontal Addressing Mode
+
+		///////////////////////////////////////////////////////
+		// 4. Hardware Configuration (Panel resolution & layout related) Command Table
+		///////////////////////////////////////////////////////
+
+		// Set Display Start Line (0x40 + startLine)
+		WriteCmd(0x40);
+
+		// Set Segment Re-map
+		// 0xA0: column address 0 is mapped to SEG0 (RESET)
+		// 0xA1: column address 127 is mapped to SEG0
+
+		// Set COM Output Scan Direction
+		// 0xC0: normal mode (RESET) Scan from COM0 to COM[N –1]
+		// 0xC8: remapped mode. Scan from COM[N-1] to COM0
+
+		// 90/270 are the transposed page store plus one mirror.
+		switch( m_nRotate )
+		{
+		case 0:		WriteCmd(0xA0);	WriteCmd(0xC0);	break;
+		case 90:	WriteCmd(0xA0);	WriteCmd(0xC8);	break;
+		case 180:	WriteCmd(0xA1);	WriteCmd(0xC8);	break;
+		case 270:	WriteCmd(0xA1);	WriteCmd(0xC0);	break;
+		}
+
+		// Set MUX ratio to N+1 MUX
+//		WriteCmd(0xA8);
+//		WriteCmd(0x3F); // ResetValue=0x3F
+
+		// Set Display Offset
+		WriteCmd(0xD3);
+		WriteCmd(0x00);
+
+		// Set COM Pins Hardware Configuration
+//		WriteCmd(0xDA);
+//		WriteCmd(0x12); // ResetValue=0x12
+
+		///////////////////////////////////////////////////////
+		// 5. Timing & Driving Scheme Setting Command Table
+		///////////////////////////////////////////////////////
+
+		// Set Display Clock Divide Ratio/Oscillator Frequency
+//		WriteCmd(0xD5);
+//		WriteCmd(0x80); // ResetValue=0x80
+
+		// Set Pre-charge Period
+//		WriteCmd(0xD9);
+//		WriteCmd(0xF1); // ResetValue=0x22
+
+		// Set VCOMH Deselect Level
+//		WriteCmd(0xDB);
+//		WriteCmd(0x40); // ReserValue=0x20
+
+		Commit();
+
+		m_tDispSize.width	= m_isTransposed ?  64 : 128;
+		m_tDispSize.height	= m_isTransposed ? 128 :  64;
+		
+		return	0;
+	}
+
+	virtual int DispClear()
+	{
+		memset( m_iPageBuf, 0, sizeof(m_iPageBuf) );
+		memset( m_iShadow, 0, sizeof(m_iShadow) );
+		ResetDirty();
+
+		if( m_isPageMode )
+		{
+			// whole 132 column RAM, one transaction per page.
+			static	const uint8_t	zero[132]	= {0};
+
+			for( int p = 0; p < 8; p++ )
+			{
+				uint8_t		cmds[3];
+
+				cmds[0]	= 0xB0 | p;		// Set Page Address
+				cmds[1]	= 0x10;			// #set higher column address
+				cmds[2]	= 0x00;			// #set lower column address
+
+				WriteCmdData( cmds, 3, zero, sizeof(zero) );
+			}
+		}
+		else
+		{
+			SendWindow( 0, 127, 0, 7 );
+		}
+
+		Commit();
+
+		return	0;
+	}
+
+	virtual int DispOn()
+	{
+		printf( "Display_SSD1306::DispOn()\n");
+
+		// Charge Pump Setting
+		WriteCmd(0x8D);
+		WriteCmd(0x14);
+
+		// Display ON in normal mode
+		WriteCmd(0xAF);	
+
+		Commit();
+
+		return	0;
+	}
+
+	virtual int DispOff()
+	{
+		printf( "Display_SSD1306::DispOff()\n");
+
+		WriteCmd(0xAE);		// #display off
+
+		Commit();
+
+		return	0;
+	}
+
+	virtual int Quit()
+	{
+		printf( "Display_SSD1306::Quit()\n");
+
+		m_tDispSize.width	= 0;
+		m_tDispSize.height	= 0;
+
+		return	0;
+	}
+
+	//	Fused path: every source row is converted, dithered and merged into the
+	//	1bpp page store, and each page is sent as soon as its last row is done.
+	virtual	int WriteImageBGRA( int x, int y, const uint8_t* image, int stride, int cx, int cy )
+	{
+		if( _CalcTransArea( x, y, image, stride, 4, cx, cy ) )
+		{
+			auto	load	= [&]( int r, uint8_t* buf )->const uint8_t*
+			{
+				ImageConvert::BGRA8888toGRAY8( image + stride * r, stride, cx, 1, buf, cx );
+				return	buf;
+			};
+
+			auto	store	= [&]( int r, const uint8_t* line )
+			{
+				StoreRow( x, y + r, line, cx, y, (r + 1) == cy );
+			};
+
+			if( NULL != m_pHalftone )
+			{
+				uint8_t		line[128];
+
+				for( int r = 0; r < cy; r++ )
+				{
+					load( r, line );
+
+					ImageHalftoning::OrderedDither( line, cx, cx, 1, *m_pHalftone, x, y + r );
+					store( r, line );
+				}
+			}
+			else
+			{
+				ImageHalftoning::ErrDiffStream_LinearFloydSteinberg( cx, cy, load, store );
+			}
+
+			TransferDirty();
+		}
+
+		return	-1;
+	}
+
+
+	virtual	int	WriteImageGRAY( int x, int y, const uint8_t* image, int stride, int cx, int cy )
+	{
+		if( _CalcTransArea( x, y, image, stride, 1, cx, cy ) )
+		{
+			for( int r = 0; r < cy; r++ )
+			{
+				StoreRow( x, y + r, image + stride * r, cx, y, (r + 1) == cy );
+			}
+
+			TransferDirty();
+		}
+		
+		return	-1;
+	}
+	
+	// Text and other 1bpp sources, no threshold or dithering.
+	virtual	int WriteImage1BPP( int x, int y, const uint8_t* image, int stride, int cx, int cy )
+	{
+		int		bit_x;
+
+		if( _CalcTransArea1BPP( x, y, image, stride, bit_x, cx, cy ) )
+		{
+			uint8_t		line[128];
+
+			for( int r = 0; r < cy; r++ )
+			{
+				ImageBitPack::BitsToGRAY8( image + stride * r, bit_x, cx, line );
+				StoreRow( x, y + r, line, cx, y, (r + 1) == cy );
+			}
+
+			TransferDirty();
+		}
+
+		return	-1;
+	}
+	
+	virtual	int GetBPP()
+	{
+		return	1;
+	}
+
+	// Ordered dithering for WriteImageBGRA(). (NULL = linear error diffusion)
+	// The matrix is anchored to the screen, so partial updates do not shimmer.
+	void	SetHalftoneMatrix( const ImageHalftoning::ThresholdMatrix* pMatrix )
+	{
+		m_pHalftone	= pMatrix;
+	}
+
+protected:
+	// Transport. Send nCmds command bytes, then nData bytes of display RAM data.
+	// May be queued until Commit().
+	virtual	void	WriteCmdData( const uint8_t* cmds, int nCmds, const uint8_t* data, int nData ) = 0;
+
+	// Flush queued transfers.
+	virtual	void	Commit()
+	{
+	}
+
+	void    WriteCmd( unsigned char cmd )
+	{
+		WriteCmdData( &cmd, 1, NULL, 0 );
+	}
+	
+	// Collect rows (0..255, MSB = on) in an 8 row strip. When the last row of
+	// a page or of the update (y0 = first row of the update) arrives, the
+	// strip is packed into page bytes, merged into the page store with a row
+	// mask, and the columns are marked dirty.
+	void	StoreRow( int x, int y, const uint8_t* line, int cx, int y0, bool isLastRow )
+	{
+		if( m_isTransposed )
+		{
+			StoreColumn( x, y, line, cx );
+			return;
+		}
+
+		const int	bit	= y & 7;
+
+		memcpy( &m_iStrip[bit][x], line, cx );
+
+		if( (7 == bit) || isLastRow )
+		{
+			const int		p		= y / 8;
+			const int		top		= y0 < (p * 8) ? 0 : y0 & 7;
+			const uint8_t	mask	= (0xFF << top) & (0xFF >> (7 - bit));
+			uint8_t*		dst		= &m_iPageBuf[p][x];
+
+			if( 0xFF == mask )
+			{
+				ImageBitPack::GRAY8toPage( &m_iStrip[0][x], sizeof(m_iStrip[0]), 8, cx, dst );
+			}
+			else
+			{
+				uint8_t		packed[128];
+
+				ImageBitPack::GRAY8toPage( &m_iStrip[0][x], sizeof(m_iStrip[0]), 8, cx, packed );
+
+				for( int i = 0; i < cx; i++ )
+				{
+					dst[i]	= (dst[i] & ~mask) | (packed[i] & mask);
+				}
+			}
+
+			if( x < m_nDirtyL[p] )			m_nDirtyL[p]	= x;
+			if( m_nDirtyR[p] < (x + cx) )	m_nDirtyR[p]	= x + cx;
+		}
+	}
+
+	// 90/270: logical row y is page column y, logical x is panel row x.
+	// The row is packed 8 pixels per byte and merged with a bit mask, so no strip is needed.
+	void	StoreColumn( int x, int y, const uint8_t* line, int cx )
+	{
+		uint8_t		bits[8]	= {0};
+		uint64_t	v		= 0;
+		uint64_t	mask	= 64 == cx ? ~0ULL : (1ULL << cx) - 1;
+
+		ImageBitPack::GRAY8toBits( line, cx, bits );
+
+		for( int i = 0; i < 8; i++ )
+		{
+			v	|= (uint64_t)bits[i] << (i * 8);
+		}
+
+		// align to the first page. ((x & 7) + cx <= 64 - (x & ~7))
+		v		<<= x & 7;
+		mask	<<= x & 7;
+
+		for( int p = x / 8; p <= (x + cx - 1) / 8; p++ )
+		{
+			const uint8_t	m	= (uint8_t)mask;
+			uint8_t&		dst	= m_iPageBuf[p][y];
+
+			dst		= (dst & ~m) | ((uint8_t)v & m);
+			v		>>= 8;
+			mask	>>= 8;
+
+			if( y < m_nDirtyL[p] )			m_nDirtyL[p]	= y;
+			if( m_nDirtyR[p] < (y + 1) )	m_nDirtyR[p]	= y + 1;
+		}
+	}
+
+	void	ResetDirty()
+	{
+		for( int p = 0; p < 8; p++ )
+		{
+			m_nDirtyL[p]	= 128;
+			m_nDirtyR[p]	= 0;
+		}
+	}
+
+	// Send the columns that differ from the panel shadow.
+	//	- One window (0x21/0x22) over all changed pages as a single data stream,
+	//	  unless separate per-page windows are cheaper.
+	//	- Page addressing (SH1106): one transaction per changed page.
+	void	TransferDirty()
+	{
+		const int	OVERHEAD	= m_nWindowOverhead;
+		int			L[8];
+		int			R[8];
+		int			ps		= -1;
+		int			pe		= -1;
+		int			cs		= 128;
+		int			ce		= 0;
+		int			nPages	= 0;
+		int			nBytes	= 0;
+
+		for( int p = 0; p < 8; p++ )
+		{
+			const uint8_t*	cur	= m_iPageBuf[p];
+			const uint8_t*	old	= m_iShadow[p];
+			int				l	= m_nDirtyL[p];
+			int				r	= m_nDirtyR[p];
+
+			while( (l < r) && (cur[l] == old[l]) )		l++;
+			while( (l < r) && (cur[r-1] == old[r-1]) )	r--;
+
+			L[p]	= l;
+			R[p]	= r;
+
+			if( l < r )
+			{
+				ps		= ps < 0 ? p : ps;
+				pe		= p;
+				cs		= l < cs ? l : cs;
+				ce		= ce < r ? r : ce;
+				nBytes	+= r - l;
+				nPages++;
+			}
+		}
+
+		ResetDirty();
+
+		if( ps < 0 )
+		{
+			return;
+		}
+
+		if( m_isPageMode || ((nBytes + OVERHEAD * (nPages - 1)) < ((ce - cs) * (pe - ps + 1))) )
+		{
+			for( int p = ps; p <= pe; p++ )
+			{
+				if( L[p] < R[p] )
+				{
+					SendWindow( L[p], R[p] - 1, p, p );
+				}
+			}
+		}
+		else
+		{
+			SendWindow( cs, ce - 1, ps, pe );
+		}
+
+		Commit();
+	}
+
+	// Send columns cs..ce of pages ps..pe as one transfer, and update the shadow.
+	void	SendWindow( int cs, int ce, int ps, int pe )
+	{
+		uint8_t		cmds[6];
+		uint8_t		data[128 * 8];
+		int			nCmds	= 0;
+		int			n		= 0;
+
+		if( m_isPageMode )
+		{
+			int		xs	= m_nXoffset + cs;
+
+			cmds[nCmds++]	= 0xB0 | ps;					// Set Page Address
+			cmds[nCmds++]	= 0x10 | (0x0F & (xs >> 4));	// #set higher column address
+			cmds[nCmds++]	= 0x00 | (0x0F & xs);			// #set lower column address
+		}
+		else
+		{
+			cmds[nCmds++]	= 0x21;		// Set Column Address
+			cmds[nCmds++]	= cs;
+			cmds[nCmds++]	= ce;
+			cmds[nCmds++]	= 0x22;		// Set Page Address
+			cmds[nCmds++]	= ps;
+			cmds[nCmds++]	= pe;
+		}
+
+		for( int p = ps; p <= pe; p++ )
+		{
+			memcpy( &data[n], &m_iPageBuf[p][cs], ce - cs + 1 );
+			memcpy( &m_iShadow[p][cs], &m_iPageBuf[p][cs], ce - cs + 1 );
+			n	+= ce - cs + 1;
+		}
+
+		WriteCmdData( cmds, nCmds, data, n );
+	}
+
+protected:
+	uint8_t		m_iPageBuf[8][128];		// 1bpp, SSD1306 page layout (bit n = row n)
+	uint8_t		m_iStrip[8][128];		// rows of the page being written, 0..255
+	uint8_t		m_iShadow[8][128];		// what the panel RAM holds
+	int			m_nDirtyL[8];			// written column range per page [L, R)
+	int			m_nDirtyR[8];
+	bool		m_isPageMode;
+	bool		m_isTransposed;
+	int			m_nRotate;
+	int			m_nXoffset;
+	int			m_nWindowOverhead;
+
+	const ImageHalftoning::ThresholdMatrix*	m_pHalftone;
+};
+
+#endif	//__DISPLAY_SSD1306_H_INCLUDED__
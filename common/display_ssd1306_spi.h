@@ -0,0 +1,76 @@
+
+#include <thread>
+#include "display_ssd1306.h"
+#include "ctrl_spi.h"
+#include "ctrl_gpio.h"
+
+//	4-wire SPI module. D/C# low = command, high = display RAM data.
+//	SSD1306 serial clock cycle is 100ns min, 8MHz by default.
+class Display_SSD1306_spi : public Display_SSD1306
+{
+public:
+	// Window overhead: window commands + 4 CS/DC toggles. (sysfs GPIO write ~30usec = ~32 bytes at 8MHz)
+	Display_SSD1306_spi( int nRotate = 0, int x_offset = 0, int nGpioCS=-1, int nGpioDC=201, int nGpioReset=1, int nSpiSpeed = 8000000 ) :
+		Display_SSD1306( nRotate, x_offset, 6 + 4 * 32 ),
+		m_iCS( nGpioCS ),
+		m_iDC( nGpioDC ),
+		m_iRST(nGpioReset),
+		m_iSPI( nSpiSpeed, SPI_MODE_0 )
+	{
+		// Set initial state
+		m_iCS	<< 1;
+		m_iRST	<< 1;	// Reset = high
+		m_iDC	<< 0;	// CommandMode
+	}
+
+	virtual int Init()
+	{
+		// 8.9 Reset Circuit, RES# low >= 3usec.
+		m_iRST	<< 1;	// Reset = high
+		SleepM(1);
+		m_iRST	<< 0;	// Reset = Low
+		SleepM(10);
+		m_iRST	<< 1;	// Reset = high
+		SleepM(10);
+
+		return	Display_SSD1306::Init();
+	}
+
+	virtual int Quit()
+	{
+		m_iRST	<< 0;
+
+		return	Display_SSD1306::Quit();
+	}
+
+protected:
+	static	void	SleepM(int sleep)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(sleep));
+	}
+
+	// Sent immediately, CS is held over commands and data.
+	virtual	void	WriteCmdData( const uint8_t* cmds, int nCmds, const uint8_t* data, int nData )
+	{
+		// ChipSelect
+		m_iCS	<< 0;
+
+		// Command
+		m_iDC	<< 0;
+		m_iSPI.write( cmds, nCmds );
+
+		if( 0 < nData )
+		{
+			m_iDC	<< 1;
+			m_iSPI.write( data, nData );
+		}
+
+		m_iCS	<< 1;
+	}
+
+protected:
+	GpioOut		m_iCS;
+	GpioOut		m_iDC;
+	GpioOut		m_iRST;
+	ctrl_spi	m_iSPI;
+};
@@ -0,0 +1,334 @@
+#ifndef	__IMG_BITPACK_H_INCLUDED__
+#define	__IMG_BITPACK_H_INCLUDED__
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define	IMAGE_BITPACK_NEON	1
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#define	IMAGE_BITPACK_SSE2	1
+#include <emmintrin.h>
+#endif
+
+//	1bpp packing for page addressed mono panels (SSD1306 / SH1106).
+//
+//	A page byte holds 8 vertical pixels of one column, bit n = row n.
+//	GRAY8 sources are thresholded at 128 (MSB = on), like the output of
+//	ImageHalftoning.
+//
+//	*PagesT is the transposed layout for 90/270 degree mounting: source row y
+//	becomes page column y, and 8 horizontal pixels form one page byte.
+//
+//	1bpp images (DisplayIF::WriteImage1BPP) use the *Bits row layout:
+//	(cx + 7) / 8 bytes per row, bit n = pixel n.
+//
+//	The SIMD paths produce the same result as the *_C reference functions.
+
+namespace ImageBitPack
+{
+	////////////////////////////////////////////////////////////
+	// Reference
+	////////////////////////////////////////////////////////////
+
+	// rows (1..8) rows of GRAY8 -> cx page bytes. Missing rows are 0.
+	void	GRAY8toPage_C( const uint8_t* src, int stride, int rows, int cx, uint8_t* dst )
+	{
+		for( int x = 0; x < cx; x++ )
+		{
+			uint8_t		v	= 0;
+
+			for( int r = 0; r < rows; r++ )
+			{
+				v	|= (src[ stride * r + x ] >> 7) << r;
+			}
+
+			dst[x]	= v;
+		}
+	}
+
+	// cx pixels of one GRAY8 row -> (cx + 7) / 8 bytes, bit n = pixel n. Missing bits are 0.
+	void	GRAY8toBits_C( const uint8_t* src, int cx, uint8_t* dst )
+	{
+		memset( dst, 0, (cx + 7) / 8 );
+
+		for( int x = 0; x < cx; x++ )
+		{
+			dst[x / 8]	|= (src[x] >> 7) << (x & 7);
+		}
+	}
+
+	// 8x8 bit matrix transpose.
+	// Byte r of v is row r, MSB = column 0. Byte c of the result is column c, bit r = row r.
+	uint64_t	Transpose8x8_C( uint64_t v )
+	{
+		uint64_t	t	= 0;
+
+		for( int r = 0; r < 8; r++ )
+		{
+			for( int c = 0; c < 8; c++ )
+			{
+				t	|= ((v >> (r * 8 + 7 - c)) & 1) << (c * 8 + r);
+			}
+		}
+
+		return	t;
+	}
+
+
+	////////////////////////////////////////////////////////////
+	// Optimized
+	////////////////////////////////////////////////////////////
+
+	static	inline	uint64_t	Load64( const uint8_t* p )
+	{
+		uint64_t	v;
+
+		memcpy( &v, p, 8 );
+		return	v;
+	}
+
+	// Portable 64-bit version of Transpose8x8_C(), 3 delta swaps.
+	static	inline	uint64_t	Transpose8x8( uint64_t v )
+	{
+		uint64_t	t;
+
+		// reverse bits in every byte, so bit c = column c.
+		v	= ((v >> 1) & 0x5555555555555555ULL) | ((v & 0x5555555555555555ULL) << 1);
+		v	= ((v >> 2) & 0x3333333333333333ULL) | ((v & 0x3333333333333333ULL) << 2);
+		v	= ((v >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((v & 0x0F0F0F0F0F0F0F0FULL) << 4);
+
+		t	= (v ^ (v >>  7)) & 0x00AA00AA00AA00AAULL;	v	= v ^ t ^ (t <<  7);
+		t	= (v ^ (v >> 14)) & 0x0000CCCC0000CCCCULL;	v	= v ^ t ^ (t << 14);
+		t	= (v ^ (v >> 28)) & 0x00000000F0F0F0F0ULL;	v	= v ^ t ^ (t << 28);
+
+		return	v;
+	}
+
+	// 8 rows of GRAY8 -> 8 page bytes, in a 64-bit register.
+	// Masking the MSBs and shifting row r right by (7 - r) never crosses a
+	// byte, so the 8 columns are packed in parallel without a transpose.
+	static	inline	uint64_t	GRAY8toPage64( const uint8_t* src, int stride )
+	{
+		const uint64_t	msb	= 0x8080808080808080ULL;
+
+		return	((Load64( src + stride * 0 ) & msb) >> 7) |
+				((Load64( src + stride * 1 ) & msb) >> 6) |
+				((Load64( src + stride * 2 ) & msb) >> 5) |
+				((Load64( src + stride * 3 ) & msb) >> 4) |
+				((Load64( src + stride * 4 ) & msb) >> 3) |
+				((Load64( src + stride * 5 ) & msb) >> 2) |
+				((Load64( src + stride * 6 ) & msb) >> 1) |
+				((Load64( src + stride * 7 ) & msb) >> 0);
+	}
+
+	// 8 GRAY8 pixels -> 1 byte, bit n = pixel n.
+	// The MSBs are gathered into the top byte by one multiply: pixel n is
+	// moved by 7 * (8 - n) bits to bit 56 + n, and no partial products collide.
+	static	inline	uint8_t		GRAY8toBits8( const uint8_t* src )
+	{
+		const uint64_t	msb	= 0x8080808080808080ULL;
+		uint64_t		v	= 0;
+
+		for( int i = 0; i < 8; i++ )
+		{
+			v	|= (uint64_t)src[i] << (i * 8);
+		}
+
+		return	(uint8_t)((((v & msb) >> 7) * 0x0102040810204080ULL) >> 56);
+	}
+
+	void	GRAY8toPage( const uint8_t* src, int stride, int rows, int cx, uint8_t* dst )
+	{
+		int		x	= 0;
+
+		if( 8 != rows )
+		{
+			GRAY8toPage_C( src, stride, rows, cx, dst );
+			return;
+		}
+
+#if IMAGE_BITPACK_NEON
+		for( ; (x+16) <= cx; x += 16 )
+		{
+			const uint8_t*	s	= &src[x];
+			uint8x16_t		v	= vld1q_u8( s + stride * 7 );
+
+			// shift right and insert, keeps the rows already placed above.
+			v	= vsriq_n_u8( v, vld1q_u8( s + stride * 6 ), 1 );
+			v	= vsriq_n_u8( v, vld1q_u8( s + stride * 5 ), 2 );
+			v	= vsriq_n_u8( v, vld1q_u8( s + stride * 4 ), 3 );
+			v	= vsriq_n_u8( v, vld1q_u8( s + stride * 3 ), 4 );
+			v	= vsriq_n_u8( v, vld1q_u8( s + stride * 2 ), 5 );
+			v	= vsriq_n_u8( v, vld1q_u8( s + stride * 1 ), 6 );
+			v	= vsriq_n_u8( v, vld1q_u8( s + stride * 0 ), 7 );
+
+			vst1q_u8( &dst[x], v );
+		}
+#elif IMAGE_BITPACK_SSE2
+		const __m128i	msb	= _mm_set1_epi8( (char)0x80 );
+
+		for( ; (x+16) <= cx; x += 16 )
+		{
+			const uint8_t*	s	= &src[x];
+			__m128i			v;
+
+			v	=				  _mm_srli_epi64( _mm_and_si128( _mm_loadu_si128( (const __m128i*)(s + stride * 0) ), msb ), 7 );
+			v	= _mm_or_si128( v, _mm_srli_epi64( _mm_and_si128( _mm_loadu_si128( (const __m128i*)(s + stride * 1) ), msb ), 6 ) );
+			v	= _mm_or_si128( v, _mm_srli_epi64( _mm_and_si128( _mm_loadu_si128( (const __m128i*)(s + stride * 2) ), msb ), 5 ) );
+			v	= _mm_or_si128( v, _mm_srli_epi64( _mm_and_si128( _mm_loadu_si128( (const __m128i*)(s + stride * 3) ), msb ), 4 ) );
+			v	= _mm_or_si128( v, _mm_srli_epi64( _mm_and_si128( _mm_loadu_si128( (const __m128i*)(s + stride * 4) ), msb ), 3 ) );
+			v	= _mm_or_si128( v, _mm_srli_epi64( _mm_and_si128( _mm_loadu_si128( (const __m128i*)(s + stride * 5) ), msb ), 2 ) );
+			v	= _mm_or_si128( v, _mm_srli_epi64( _mm_and_si128( _mm_loadu_si128( (const __m128i*)(s + stride * 6) ), msb ), 1 ) );
+			v	= _mm_or_si128( v,				   _mm_and_si128( _mm_loadu_si128( (const __m128i*)(s + stride * 7) ), msb ) );
+
+			_mm_storeu_si128( (__m128i*)&dst[x], v );
+		}
+#endif
+
+		for( ; (x+8) <= cx; x += 8 )
+		{
+			uint64_t	v	= GRAY8toPage64( &src[x], stride );
+
+			memcpy( &dst[x], &v, 8 );
+		}
+
+		if( x < cx )
+		{
+			GRAY8toPage_C( &src[x], stride, rows, cx - x, &dst[x] );
+		}
+	}
+
+
+	void	GRAY8toBits( const uint8_t* src, int cx, uint8_t* dst )
+	{
+		int		x	= 0;
+
+#if IMAGE_BITPACK_NEON
+		static	const uint8_t	weight[16]	= { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+		const uint8x16_t		w			= vld1q_u8( weight );
+		const uint8x16_t		half		= vdupq_n_u8( 0x80 );
+
+		for( ; (x+16) <= cx; x += 16 )
+		{
+			// on pixels keep their bit weight, the horizontal sums are the bytes.
+			uint8x16_t	v	= vandq_u8( vcgeq_u8( vld1q_u8( &src[x] ), half ), w );
+			uint64x2_t	t	= vpaddlq_u32( vpaddlq_u16( vpaddlq_u8( v ) ) );
+
+			dst[ x / 8 + 0 ]	= (uint8_t)vgetq_lane_u64( t, 0 );
+			dst[ x / 8 + 1 ]	= (uint8_t)vgetq_lane_u64( t, 1 );
+		}
+#elif IMAGE_BITPACK_SSE2
+		for( ; (x+16) <= cx; x += 16 )
+		{
+			int		m	= _mm_movemask_epi8( _mm_loadu_si128( (const __m128i*)&src[x] ) );
+
+			dst[ x / 8 + 0 ]	= (uint8_t)(m >> 0);
+			dst[ x / 8 + 1 ]	= (uint8_t)(m >> 8);
+		}
+#endif
+
+		for( ; (x+8) <= cx; x += 8 )
+		{
+			dst[ x / 8 ]	= GRAY8toBits8( &src[x] );
+		}
+
+		if( x < cx )
+		{
+			GRAY8toBits_C( &src[x], cx - x, &dst[x / 8] );
+		}
+	}
+
+
+	////////////////////////////////////////////////////////////
+	// 1bpp rows
+	////////////////////////////////////////////////////////////
+
+	// cx pixels from bit x of a 1bpp row -> GRAY8 0x00 / 0xFF.
+	void	BitsToGRAY8( const uint8_t* src, int x, int cx, uint8_t* dst )
+	{
+		for( int i = 0; i < cx; i++, x++ )
+		{
+			dst[i]	= 0 - ((src[ x / 8 ] >> (x & 7)) & 1);
+		}
+	}
+
+	// cx pixels from bit src_x of src to bit dst_x of dst, other bits of dst are kept.
+	void	CopyBits( const uint8_t* src, int src_x, uint8_t* dst, int dst_x, int cx )
+	{
+		for( int i = 0; i < cx; i++, src_x++, dst_x++ )
+		{
+			uint8_t		bit		= 1 << (dst_x & 7);
+			uint8_t&	d		= dst[ dst_x / 8 ];
+
+			if( (src[ src_x / 8 ] >> (src_x & 7)) & 1 )
+			{
+				d	|= bit;
+			}
+			else
+			{
+				d	&= ~bit;
+			}
+		}
+	}
+
+
+	////////////////////////////////////////////////////////////
+	// Whole image -> pages
+	////////////////////////////////////////////////////////////
+
+	// cx x cy GRAY8 -> (cy + 7) / 8 pages of cx bytes.
+	void	GRAY8toPages_C( const uint8_t* pSrcImage, int nSrcStride, int cx, int cy, uint8_t * pDstImage, int nDstStride )
+	{
+		for( int y = 0; y < cy; y += 8 )
+		{
+			GRAY8toPage_C( &pSrcImage[ nSrcStride * y ], nSrcStride, (cy - y) < 8 ? cy - y : 8, cx, &pDstImage[ nDstStride * (y / 8) ] );
+		}
+	}
+
+	void	GRAY8toPages( const uint8_t* pSrcImage, int nSrcStride, int cx, int cy, uint8_t * pDstImage, int nDstStride )
+	{
+		for( int y = 0; y < cy; y += 8 )
+		{
+			GRAY8toPage( &pSrcImage[ nSrcStride * y ], nSrcStride, (cy - y) < 8 ? cy - y : 8, cx, &pDstImage[ nDstStride * (y / 8) ] );
+		}
+	}
+
+	// Transposed: cx x cy GRAY8 -> (cx + 7) / 8 pages of cy bytes. (nDstStride >= cy)
+	void	GRAY8toPagesT_C( const uint8_t* pSrcImage, int nSrcStride, int cx, int cy, uint8_t * pDstImage, int nDstStride )
+	{
+		for( int y = 0; y < cy; y++ )
+		{
+			for( int x = 0; x < cx; x += 8 )
+			{
+				uint8_t		v	= 0;
+
+				GRAY8toBits_C( &pSrcImage[ nSrcStride * y + x ], (cx - x) < 8 ? cx - x : 8, &v );
+				pDstImage[ nDstStride * (x / 8) + y ]	= v;
+			}
+		}
+	}
+
+	void	GRAY8toPagesT( const uint8_t* pSrcImage, int nSrcStride, int cx, int cy, uint8_t * pDstImage, int nDstStride )
+	{
+		uint8_t		bits[ 64 ];
+
+		for( int y = 0; y < cy; y++ )
+		{
+			for( int x = 0; x < cx; x += 8 * sizeof(bits) )
+			{
+				int		n	= (cx - x) < (int)(8 * sizeof(bits)) ? cx - x : 8 * sizeof(bits);
+
+				GRAY8toBits( &pSrcImage[ nSrcStride * y + x ], n, bits );
+
+				for( int i = 0; i < (n + 7) / 8; i++ )
+				{
+					pDstImage[ nDstStride * (x / 8 + i) + y ]	= bits[i];
+				}
+			}
+		}
+	}
+};
+
+#endif	// __IMG_BITPACK_H_INCLUDED__
@@ -0,0 +1,683 @@
+#ifndef	__IMG_BLEND_H_INCLUDED__
+#define	__IMG_BLEND_H_INCLUDED__
+
+#include <stdint.h>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define	IMAGE_BLEND_NEON	1
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#define	IMAGE_BLEND_SSE2	1
+#include <emmintrin.h>
+#endif
+
+//	Alpha compositing (Porter-Duff SrcOver).
+//
+//	BGRA8888 sources are premultiplied alpha.
+//	RGB565 is the panel byte order used by ImageConvert::BGRA8888toRGB565 (MSB first).
+//	Solid colors are 0xAARRGGBB (BGRA byte order in memory), not premultiplied.
+//
+//	A8overGRAY8 / A8overBGRA8888 are the ImageFont text blend: the coverage
+//	a is weighted as (a + (a >> 7)) / 256, so 255 gives exactly the color.
+//	Blocks of fully transparent coverage are skipped and fully opaque ones
+//	are stored as the color without blending.
+//
+//	The SIMD paths produce the same result as the *_C reference functions.
+
+namespace ImageBlend
+{
+	// round( v / 255 ) for 0 <= v <= 255*255
+	static	inline	uint32_t	Div255( uint32_t v )
+	{
+		v	+= 128;
+		return	(v + (v >> 8)) >> 8;
+	}
+
+	static	inline	uint32_t	AddSat8( uint32_t a, uint32_t b )
+	{
+		a	+= b;
+		return	a < 255 ? a : 255;
+	}
+
+	static	inline	void	UnpackRGB565( const uint8_t* d, uint32_t& r, uint32_t& g, uint32_t& b )
+	{
+		uint32_t	p	= (d[0] << 8) | d[1];
+
+		r	= (p >> 11);
+		g	= (p >>  5) & 0x3F;
+		b	= (p >>  0) & 0x1F;
+
+		r	= (r << 3) | (r >> 2);
+		g	= (g << 2) | (g >> 4);
+		b	= (b << 3) | (b >> 2);
+	}
+
+	static	inline	void	PackRGB565( uint8_t* d, uint32_t r, uint32_t g, uint32_t b )
+	{
+		d[0]	= (0xF8 & r) | (0x07 & (g >> 5));
+		d[1]	= (0xE0 & (g << 3)) | (0x1F & (b >> 3));
+	}
+
+
+	static	void	BGRA8888overBGRA8888_Line( const uint8_t* s, uint8_t* d, int cx )
+	{
+		for( int x = 0; x < cx; x++, s += 4, d += 4 )
+		{
+			uint32_t	ia	= 255 - s[3];
+
+			d[0]	= AddSat8( s[0], Div255( d[0] * ia ) );
+			d[1]	= AddSat8( s[1], Div255( d[1] * ia ) );
+			d[2]	= AddSat8( s[2], Div255( d[2] * ia ) );
+			d[3]	= AddSat8( s[3], Div255( d[3] * ia ) );
+		}
+	}
+
+	static	void	BGRA8888overRGB565_Line( const uint8_t* s, uint8_t* d, int cx )
+	{
+		for( int x = 0; x < cx; x++, s += 4, d += 2 )
+		{
+			uint32_t	ia	= 255 - s[3];
+			uint32_t	r, g, b;
+
+			UnpackRGB565( d, r, g, b );
+
+			PackRGB565(
+				d,
+				AddSat8( s[2], Div255( r * ia ) ),
+				AddSat8( s[1], Div255( g * ia ) ),
+				AddSat8( s[0], Div255( b * ia ) ) );
+		}
+	}
+
+	static	void	A8overRGB565_Line( const uint8_t* m, uint32_t color, uint8_t* d, int cx )
+	{
+		uint32_t	ca	= 0xFF & (color >> 24);
+		uint32_t	cr	= 0xFF & (color >> 16);
+		uint32_t	cg	= 0xFF & (color >>  8);
+		uint32_t	cb	= 0xFF & (color >>  0);
+
+		for( int x = 0; x < cx; x++, d += 2 )
+		{
+			uint32_t	a	= Div255( m[x] * ca );
+			uint32_t	ia	= 255 - a;
+			uint32_t	r, g, b;
+
+			UnpackRGB565( d, r, g, b );
+
+			PackRGB565(
+				d,
+				Div255( cr * a + r * ia ),
+				Div255( cg * a + g * ia ),
+				Div255( cb * a + b * ia ) );
+		}
+	}
+
+
+	static	void	A8overGRAY8_Line( const uint8_t* m, uint8_t color, uint8_t* d, int cx )
+	{
+		for( int x = 0; x < cx; x++ )
+		{
+			int32_t	a	= m[x];
+
+			if( 0 < a )
+			{
+				int32_t	d0	= d[x];
+
+				a		+= a >> 7;
+				d[x]	= (uint8_t)( d0 + (((color - d0) * a) >> 8) );
+			}
+		}
+	}
+
+	static	void	A8overBGRA8888_Line( const uint8_t* m, uint32_t color, uint8_t* d, int cx )
+	{
+		const uint8_t*	clr		= (const uint8_t*)&color;
+		uint32_t		alpha	= (color >> 24) + (color >> 31);
+
+		for( int x = 0; x < cx; x++, d += 4 )
+		{
+			int32_t	a	= m[x];
+
+			if( 0 < a )
+			{
+				int32_t	d0	= d[0];
+				int32_t	d1	= d[1];
+				int32_t	d2	= d[2];
+				int32_t	d3	= d[3];
+
+				a	+= a >> 7;
+				a	*= alpha;
+
+				d[0]	= (uint8_t)( ((d0 << 16) + (clr[0] - d0) * a) >> 16 );
+				d[1]	= (uint8_t)( ((d1 << 16) + (clr[1] - d1) * a) >> 16 );
+				d[2]	= (uint8_t)( ((d2 << 16) + (clr[2] - d2) * a) >> 16 );
+				d[3]	= (uint8_t)( ((d3 << 16) + (clr[3] - d3) * a) >> 16 );
+			}
+		}
+	}
+
+
+	////////////////////////////////////////////////////////////
+	// Reference implementation
+	////////////////////////////////////////////////////////////
+
+	void	BGRA8888overBGRA8888_C( const uint8_t* pSrcImage, int nSrcStride, int cx, int cy, uint8_t * pDstImage, int nDstStride )
+	{
+		for( int y = 0; y < cy; y++ )
+		{
+			BGRA8888overBGRA8888_Line( &pSrcImage[ nSrcStride * y ], &pDstImage[ nDstStride * y ], cx );
+		}
+	}
+
+	void	BGRA8888overRGB565_C( const uint8_t* pSrcImage, int nSrcStride, int cx, int cy, uint8_t * pDstImage, int nDstStride )
+	{
+		for( int y = 0; y < cy; y++ )
+		{
+			BGRA8888overRGB565_Line( &pSrcImage[ nSrcStride * y ], &pDstImage[ nDstStride * y ], cx );
+		}
+	}
+
+	void	A8overRGB565_C( const uint8_t* pMask, int nMaskStride, int cx, int cy, uint32_t color, uint8_t * pDstImage, int nDstStride )
+	{
+		for( int y = 0; y < cy; y++ )
+		{
+			A8overRGB565_Line( &pMask[ nMaskStride * y ], color, &pDstImage[ nDstStride * y ], cx );
+		}
+	}
+
+	void	A8overGRAY8_C( const uint8_t* pMask, int nMaskStride, int cx, int cy, uint8_t color, uint8_t * pDstImage, int nDstStride )
+	{
+		for( int y = 0; y < cy; y++ )
+		{
+			A8overGRAY8_Line( &pMask[ nMaskStride * y ], color, &pDstImage[ nDstStride * y ], cx );
+		}
+	}
+
+	void	A8overBGRA8888_C( const uint8_t* pMask, int nMaskStride, int cx, int cy, uint32_t color, uint8_t * pDstImage, int nDstStride )
+	{
+		for( int y = 0; y < cy; y++ )
+		{
+			A8overBGRA8888_Line( &pMask[ nMaskStride * y ], color, &pDstImage[ nDstStride * y ], cx );
+		}
+	}
+
+
+	////////////////////////////////////////////////////////////
+	// SIMD helpers
+	////////////////////////////////////////////////////////////
+
+#if IMAGE_BLEND_NEON
+	// Div255() for 8 lanes, narrowed to uint8.
+	static	inline	uint8x8_t	Div255_NEON( uint16x8_t v )
+	{
+		return	vrshrn_n_u16( vrsraq_n_u16( v, v, 8 ), 8 );
+	}
+
+	static	inline	void	LoadRGB565_NEON( const uint8_t* d, uint8x8_t& r, uint8x8_t& g, uint8x8_t& b )
+	{
+		uint16x8_t	p	= vreinterpretq_u16_u8( vrev16q_u8( vld1q_u8( d ) ) );
+		uint8x8_t	r5	= vmovn_u16( vshrq_n_u16( p, 11 ) );
+		uint8x8_t	g6	= vand_u8( vmovn_u16( vshrq_n_u16( p, 5 ) ), vdup_n_u8( 0x3F ) );
+		uint8x8_t	b5	= vand_u8( vmovn_u16( p ), vdup_n_u8( 0x1F ) );
+
+		r	= vorr_u8( vshl_n_u8( r5, 3 ), vshr_n_u8( r5, 2 ) );
+		g	= vorr_u8( vshl_n_u8( g6, 2 ), vshr_n_u8( g6, 4 ) );
+		b	= vorr_u8( vshl_n_u8( b5, 3 ), vshr_n_u8( b5, 2 ) );
+	}
+
+	static	inline	void	StoreRGB565_NEON( uint8_t* d, uint8x8_t r, uint8x8_t g, uint8x8_t b )
+	{
+		uint16x8_t	p	= vandq_u16( vshll_n_u8( r, 8 ), vdupq_n_u16( 0xF800 ) );
+
+		p	= vorrq_u16( p, vandq_u16( vshrq_n_u16( vshll_n_u8( g, 8 ), 5 ), vdupq_n_u16( 0x07E0 ) ) );
+		p	= vorrq_u16( p, vmovl_u8( vshr_n_u8( b, 3 ) ) );
+
+		vst1q_u8( d, vrev16q_u8( vreinterpretq_u8_u16( p ) ) );
+	}
+
+	// 8 coverage bytes all 0x00 / all 0xFF
+	static	inline	bool	IsClear_NEON( uint8x8_t m )
+	{
+		return	0 == vget_lane_u64( vreinterpret_u64_u8( m ), 0 );
+	}
+
+	static	inline	bool	IsOpaque_NEON( uint8x8_t m )
+	{
+		return	~0ULL == vget_lane_u64( vreinterpret_u64_u8( m ), 0 );
+	}
+
+	// (d * (256 - a) + c * a) >> 8, a = coverage + (coverage >> 7)
+	static	inline	uint8x8_t	BlendA8_NEON( uint8x8_t d, uint16x8_t c, uint16x8_t a, uint16x8_t ia )
+	{
+		return	vshrn_n_u16( vmlaq_u16( vmulq_u16( vmovl_u8( d ), ia ), c, a ), 8 );
+	}
+#endif
+
+#if IMAGE_BLEND_SSE2
+	// Div255() for 8 x 16bit lanes.
+	static	inline	__m128i	Div255_SSE2( __m128i v )
+	{
+		v	= _mm_add_epi16( v, _mm_set1_epi16( 128 ) );
+		return	_mm_srli_epi16( _mm_add_epi16( v, _mm_srli_epi16( v, 8 ) ), 8 );
+	}
+
+	// 16bit lanes [b,g,r,a,b,g,r,a] -> [a,a,a,a,a,a,a,a]
+	static	inline	__m128i	BroadcastAlpha_SSE2( __m128i v )
+	{
+		v	= _mm_shufflelo_epi16( v, _MM_SHUFFLE(3,3,3,3) );
+		return	_mm_shufflehi_epi16( v, _MM_SHUFFLE(3,3,3,3) );
+	}
+
+	// 8 x RGB565(MSB first) -> 16bit lanes of 8bit r,g,b
+	static	inline	void	LoadRGB565_SSE2( const uint8_t* d, __m128i& r, __m128i& g, __m128i& b )
+	{
+		__m128i	p	= _mm_loadu_si128( (const __m128i*)d );
+		__m128i	m5	= _mm_set1_epi16( 0x1F );
+
+		p	= _mm_or_si128( _mm_slli_epi16( p, 8 ), _mm_srli_epi16( p, 8 ) );
+		r	= _mm_srli_epi16( p, 11 );
+		g	= _mm_and_si128( _mm_srli_epi16( p, 5 ), _mm_set1_epi16( 0x3F ) );
+		b	= _mm_and_si128( p, m5 );
+
+		r	= _mm_or_si128( _mm_slli_epi16( r, 3 ), _mm_srli_epi16( r, 2 ) );
+		g	= _mm_or_si128( _mm_slli_epi16( g, 2 ), _mm_srli_epi16( g, 4 ) );
+		b	= _mm_or_si128( _mm_slli_epi16( b, 3 ), _mm_srli_epi16( b, 2 ) );
+	}
+
+	static	inline	void	StoreRGB565_SSE2( uint8_t* d, __m128i r, __m128i g, __m128i b )
+	{
+		__m128i	p;
+
+		p	= _mm_and_si128( _mm_slli_epi16( r, 8 ), _mm_set1_epi16( (short)0xF800 ) );
+		p	= _mm_or_si128( p, _mm_and_si128( _mm_slli_epi16( g, 3 ), _mm_set1_epi16( 0x07E0 ) ) );
+		p	= _mm_or_si128( p, _mm_srli_epi16( b, 3 ) );
+		p	= _mm_or_si128( _mm_slli_epi16( p, 8 ), _mm_srli_epi16( p, 8 ) );
+
+		_mm_storeu_si128( (__m128i*)d, p );
+	}
+
+	// (d * (256 - a) + c * a) >> 8 for 16bit lanes, a = coverage + (coverage >> 7)
+	static	inline	__m128i	BlendA8_SSE2( __m128i d, __m128i c, __m128i a )
+	{
+		__m128i	ia	= _mm_sub_epi16( _mm_set1_epi16( 256 ), a );
+
+		return	_mm_srli_epi16( _mm_add_epi16( _mm_mullo_epi16( d, ia ), _mm_mullo_epi16( c, a ) ), 8 );
+	}
+
+	// 16bit lanes [a0..a7] -> one lane per BGRA byte: [a0,a0,a0,a0,a1,a1,a1,a1], ... [a6 x4, a7 x4]
+	static	inline	void	SplatA8x4_SSE2( __m128i a, __m128i& a01, __m128i& a23, __m128i& a45, __m128i& a67 )
+	{
+		__m128i	lo	= _mm_unpacklo_epi16( a, a );
+		__m128i	hi	= _mm_unpackhi_epi16( a, a );
+
+		a01	= _mm_unpacklo_epi32( lo, lo );
+		a23	= _mm_unpackhi_epi32( lo, lo );
+		a45	= _mm_unpacklo_epi32( hi, hi );
+		a67	= _mm_unpackhi_epi32( hi, hi );
+	}
+#endif
+
+
+	////////////////////////////////////////////////////////////
+	// SrcOver
+	////////////////////////////////////////////////////////////
+
+	void	BGRA8888overBGRA8888( const uint8_t* pSrcImage, int nSrcStride, int cx, int cy, uint8_t * pDstImage, int nDstStride )
+	{
+		for( int y = 0; y < cy; y++ )
+		{
+			const uint8_t*	s	= &pSrcImage[ nSrcStride * y ];
+			uint8_t*		d	= &pDstImage[ nDstStride * y ];
+			int				x	= 0;
+
+#if IMAGE_BLEND_NEON
+			for( ; (x+8) <= cx; x += 8 )
+			{
+				uint8x8x4_t	sv	= vld4_u8( &s[x*4] );
+				uint8x8x4_t	dv	= vld4_u8( &d[x*4] );
+				uint8x8_t	ia	= vmvn_u8( sv.val[3] );
+
+				dv.val[0]	= vqadd_u8( sv.val[0], Div255_NEON( vmull_u8( dv.val[0], ia ) ) );
+				dv.val[1]	= vqadd_u8( sv.val[1], Div255_NEON( vmull_u8( dv.val[1], ia ) ) );
+				dv.val[2]	= vqadd_u8( sv.val[2], Div255_NEON( vmull_u8( dv.val[2], ia ) ) );
+				dv.val[3]	= vqadd_u8( sv.val[3], Div255_NEON( vmull_u8( dv.val[3], ia ) ) );
+
+				vst4_u8( &d[x*4], dv );
+			}
+#elif IMAGE_BLEND_SSE2
+			__m128i	zero	= _mm_setzero_si128();
+			__m128i	c255	= _mm_set1_epi16( 255 );
+
+			for( ; (x+4) <= cx; x += 4 )
+			{
+				__m128i	sv	= _mm_loadu_si128( (const __m128i*)&s[x*4] );
+				__m128i	dv	= _mm_loadu_si128( (const __m128i*)&d[x*4] );
+				__m128i	dl	= _mm_unpacklo_epi8( dv, zero );
+				__m128i	dh	= _mm_unpackhi_epi8( dv, zero );
+				__m128i	ial	= _mm_sub_epi16( c255, BroadcastAlpha_SSE2( _mm_unpacklo_epi8( sv, zero ) ) );
+				__m128i	iah	= _mm_sub_epi16( c255, BroadcastAlpha_SSE2( _mm_unpackhi_epi8( sv, zero ) ) );
+
+				dl	= Div255_SSE2( _mm_mullo_epi16( dl, ial ) );
+				dh	= Div255_SSE2( _mm_mullo_epi16( dh, iah ) );
+
+				_mm_storeu_si128( (__m128i*)&d[x*4], _mm_adds_epu8( sv, _mm_packus_epi16( dl, dh ) ) );
+			}
+#endif
+
+			BGRA8888overBGRA8888_Line( &s[x*4], &d[x*4], cx - x );
+		}
+	}
+
+	void	BGRA8888overRGB565( const uint8_t* pSrcImage, int nSrcStride, int cx, int cy, uint8_t * pDstImage, int nDstStride )
+	{
+		for( int y = 0; y < cy; y++ )
+		{
+			const uint8_t*	s	= &pSrcImage[ nSrcStride * y ];
+			uint8_t*		d	= &pDstImage[ nDstStride * y ];
+			int				x	= 0;
+
+#if IMAGE_BLEND_NEON
+			for( ; (x+8) <= cx; x += 8 )
+			{
+				uint8x8x4_t	sv	= vld4_u8( &s[x*4] );
+				uint8x8_t	ia	= vmvn_u8( sv.val[3] );
+				uint8x8_t	r, g, b;
+
+				LoadRGB565_NEON( &d[x*2], r, g, b );
+
+				r	= vqadd_u8( sv.val[2], Div255_NEON( vmull_u8( r, ia ) ) );
+				g	= vqadd_u8( sv.val[1], Div255_NEON( vmull_u8( g, ia ) ) );
+				b	= vqadd_u8( sv.val[0], Div255_NEON( vmull_u8( b, ia ) ) );
+
+				StoreRGB565_NEON( &d[x*2], r, g, b );
+			}
+#elif IMAGE_BLEND_SSE2
+			__m128i	m8		= _mm_set1_epi32( 0xFF );
+			__m128i	c255	= _mm_set1_epi16( 255 );
+
+			for( ; (x+8) <= cx; x += 8 )
+			{
+				__m128i	s0	= _mm_loadu_si128( (const __m128i*)&s[x*4+ 0] );
+				__m128i	s1	= _mm_loadu_si128( (const __m128i*)&s[x*4+16] );
+				__m128i	sb	= _mm_packs_epi32( _mm_and_si128( s0, m8 ),                     _mm_and_si128( s1, m8 ) );
+				__m128i	sg	= _mm_packs_epi32( _mm_and_si128( _mm_srli_epi32( s0,  8 ), m8 ), _mm_and_si128( _mm_srli_epi32( s1,  8 ), m8 ) );
+				__m128i	sr	= _mm_packs_epi32( _mm_and_si128( _mm_srli_epi32( s0, 16 ), m8 ), _mm_and_si128( _mm_srli_epi32( s1, 16 ), m8 ) );
+				__m128i	ia	= _mm_sub_epi16( c255, _mm_packs_epi32( _mm_srli_epi32( s0, 24 ), _mm_srli_epi32( s1, 24 ) ) );
+				__m128i	r, g, b;
+
+				LoadRGB565_SSE2( &d[x*2], r, g, b );
+
+				r	= _mm_min_epi16( _mm_add_epi16( sr, Div255_SSE2( _mm_mullo_epi16( r, ia ) ) ), c255 );
+				g	= _mm_min_epi16( _mm_add_epi16( sg, Div255_SSE2( _mm_mullo_epi16( g, ia ) ) ), c255 );
+				b	= _mm_min_epi16( _mm_add_epi16( sb, Div255_SSE2( _mm_mullo_epi16( b, ia ) ) ), c255 );
+
+				StoreRGB565_SSE2( &d[x*2], r, g, b );
+			}
+#endif
+
+			BGRA8888overRGB565_Line( &s[x*4], &d[x*2], cx - x );
+		}
+	}
+
+	void	A8overRGB565( const uint8_t* pMask, int nMaskStride, int cx, int cy, uint32_t color, uint8_t * pDstImage, int nDstStride )
+	{
+		for( int y = 0; y < cy; y++ )
+		{
+			const uint8_t*	m	= &pMask[ nMaskStride * y ];
+			uint8_t*		d	= &pDstImage[ nDstStride * y ];
+			int				x	= 0;
+
+#if IMAGE_BLEND_NEON
+			uint8x8_t	ca	= vdup_n_u8( 0xFF & (color >> 24) );
+			uint8x8_t	cr	= vdup_n_u8( 0xFF & (color >> 16) );
+			uint8x8_t	cg	= vdup_n_u8( 0xFF & (color >>  8) );
+			uint8x8_t	cb	= vdup_n_u8( 0xFF & (color >>  0) );
+			bool		isOpaqueColor	= 0xFF000000 == (color & 0xFF000000);
+
+			for( ; (x+8) <= cx; x += 8 )
+			{
+				uint8x8_t	mv	= vld1_u8( &m[x] );
+
+				if( IsClear_NEON( mv ) )
+				{
+					continue;
+				}
+
+				if( isOpaqueColor && IsOpaque_NEON( mv ) )
+				{
+					StoreRGB565_NEON( &d[x*2], cr, cg, cb );
+					continue;
+				}
+
+				uint8x8_t	a	= Div255_NEON( vmull_u8( mv, ca ) );
+				uint8x8_t	ia	= vmvn_u8( a );
+				uint8x8_t	r, g, b;
+
+				LoadRGB565_NEON( &d[x*2], r, g, b );
+
+				r	= Div255_NEON( vmlal_u8( vmull_u8( cr, a ), r, ia ) );
+				g	= Div255_NEON( vmlal_u8( vmull_u8( cg, a ), g, ia ) );
+				b	= Div255_NEON( vmlal_u8( vmull_u8( cb, a ), b, ia ) );
+
+				StoreRGB565_NEON( &d[x*2], r, g, b );
+			}
+#elif IMAGE_BLEND_SSE2
+			__m128i	zero	= _mm_setzero_si128();
+			__m128i	c255	= _mm_set1_epi16( 255 );
+			__m128i	ca		= _mm_set1_epi16( 0xFF & (color >> 24) );
+			__m128i	cr		= _mm_set1_epi16( 0xFF & (color >> 16) );
+			__m128i	cg		= _mm_set1_epi16( 0xFF & (color >>  8) );
+			__m128i	cb		= _mm_set1_epi16( 0xFF & (color >>  0) );
+			bool	isOpaqueColor	= 0xFF000000 == (color & 0xFF000000);
+
+			for( ; (x+8) <= cx; x += 8 )
+			{
+				__m128i	mv		= _mm_loadl_epi64( (const __m128i*)&m[x] );
+				int		nClear	= 0xFF & _mm_movemask_epi8( _mm_cmpeq_epi8( mv, zero ) );
+				int		nOpaque	= 0xFF & _mm_movemask_epi8( _mm_cmpeq_epi8( mv, _mm_set1_epi8( -1 ) ) );
+
+				if( 0xFF == nClear )
+				{
+					continue;
+				}
+
+				if( isOpaqueColor && (0xFF == nOpaque) )
+				{
+					StoreRGB565_SSE2( &d[x*2], cr, cg, cb );
+					continue;
+				}
+
+				__m128i	a	= Div255_SSE2( _mm_mullo_epi16( _mm_unpacklo_epi8( mv, zero ), ca ) );
+				__m128i	ia	= _mm_sub_epi16( c255, a );
+				__m128i	r, g, b;
+
+				LoadRGB565_SSE2( &d[x*2], r, g, b );
+
+				r	= Div255_SSE2( _mm_add_epi16( _mm_mullo_epi16( cr, a ), _mm_mullo_epi16( r, ia ) ) );
+				g	= Div255_SSE2( _mm_add_epi16( _mm_mullo_epi16( cg, a ), _mm_mullo_epi16( g, ia ) ) );
+				b	= Div255_SSE2( _mm_add_epi16( _mm_mullo_epi16( cb, a ), _mm_mullo_epi16( b, ia ) ) );
+
+				StoreRGB565_SSE2( &d[x*2], r, g, b );
+			}
+#endif
+
+			A8overRGB565_Line( &m[x], color, &d[x*2], cx - x );
+		}
+	}
+
+	void	A8overGRAY8( const uint8_t* pMask, int nMaskStride, int cx, int cy, uint8_t color, uint8_t * pDstImage, int nDstStride )
+	{
+		for( int y = 0; y < cy; y++ )
+		{
+			const uint8_t*	m	= &pMask[ nMaskStride * y ];
+			uint8_t*		d	= &pDstImage[ nDstStride * y ];
+			int				x	= 0;
+
+#if IMAGE_BLEND_NEON
+			uint16x8_t	c	= vdupq_n_u16( color );
+			uint16x8_t	c256	= vdupq_n_u16( 256 );
+
+			for( ; (x+16) <= cx; x += 16 )
+			{
+				uint8x16_t	mv	= vld1q_u8( &m[x] );
+				uint8x8_t	ml	= vget_low_u8( mv );
+				uint8x8_t	mh	= vget_high_u8( mv );
+
+				if( IsClear_NEON( vorr_u8( ml, mh ) ) )
+				{
+					continue;
+				}
+
+				if( IsOpaque_NEON( vand_u8( ml, mh ) ) )
+				{
+					vst1q_u8( &d[x], vdupq_n_u8( color ) );
+					continue;
+				}
+
+				uint8x16_t	dv	= vld1q_u8( &d[x] );
+				uint16x8_t	al	= vmovl_u8( ml );
+				uint16x8_t	ah	= vmovl_u8( mh );
+
+				al	= vsraq_n_u16( al, al, 7 );
+				ah	= vsraq_n_u16( ah, ah, 7 );
+
+				vst1q_u8( &d[x], vcombine_u8(
+					BlendA8_NEON( vget_low_u8( dv ),  c, al, vsubq_u16( c256, al ) ),
+					BlendA8_NEON( vget_high_u8( dv ), c, ah, vsubq_u16( c256, ah ) ) ) );
+			}
+#elif IMAGE_BLEND_SSE2
+			__m128i	zero	= _mm_setzero_si128();
+			__m128i	ff		= _mm_set1_epi8( -1 );
+			__m128i	c		= _mm_set1_epi16( color );
+
+			for( ; (x+16) <= cx; x += 16 )
+			{
+				__m128i	mv	= _mm_loadu_si128( (const __m128i*)&m[x] );
+
+				if( 0xFFFF == _mm_movemask_epi8( _mm_cmpeq_epi8( mv, zero ) ) )
+				{
+					continue;
+				}
+
+				if( 0xFFFF == _mm_movemask_epi8( _mm_cmpeq_epi8( mv, ff ) ) )
+				{
+					_mm_storeu_si128( (__m128i*)&d[x], _mm_set1_epi8( (char)color ) );
+					continue;
+				}
+
+				__m128i	dv	= _mm_loadu_si128( (const __m128i*)&d[x] );
+				__m128i	al	= _mm_unpacklo_epi8( mv, zero );
+				__m128i	ah	= _mm_unpackhi_epi8( mv, zero );
+
+				al	= _mm_add_epi16( al, _mm_srli_epi16( al, 7 ) );
+				ah	= _mm_add_epi16( ah, _mm_srli_epi16( ah, 7 ) );
+
+				_mm_storeu_si128( (__m128i*)&d[x], _mm_packus_epi16(
+					BlendA8_SSE2( _mm_unpacklo_epi8( dv, zero ), c, al ),
+					BlendA8_SSE2( _mm_unpackhi_epi8( dv, zero ), c, ah ) ) );
+			}
+#endif
+
+			A8overGRAY8_Line( &m[x], color, &d[x], cx - x );
+		}
+	}
+
+	// The SIMD paths cover opaque colors (the text case), a translucent color uses the C path.
+	void	A8overBGRA8888( const uint8_t* pMask, int nMaskStride, int cx, int cy, uint32_t color, uint8_t * pDstImage, int nDstStride )
+	{
+		bool	isOpaqueColor	= 0xFF000000 == (color & 0xFF000000);
+
+		for( int y = 0; y < cy; y++ )
+		{
+			const uint8_t*	m	= &pMask[ nMaskStride * y ];
+			uint8_t*		d	= &pDstImage[ nDstStride * y ];
+			int				x	= 0;
+
+#if IMAGE_BLEND_NEON
+			uint16x8_t	c0		= vdupq_n_u16( 0xFF & (color >>  0) );
+			uint16x8_t	c1		= vdupq_n_u16( 0xFF & (color >>  8) );
+			uint16x8_t	c2		= vdupq_n_u16( 0xFF & (color >> 16) );
+			uint16x8_t	c3		= vdupq_n_u16( 0xFF & (color >> 24) );
+			uint16x8_t	c256	= vdupq_n_u16( 256 );
+
+			for( ; isOpaqueColor && ((x+8) <= cx); x += 8 )
+			{
+				uint8x8_t	mv	= vld1_u8( &m[x] );
+
+				if( IsClear_NEON( mv ) )
+				{
+					continue;
+				}
+
+				if( IsOpaque_NEON( mv ) )
+				{
+					uint32x4_t	cv	= vdupq_n_u32( color );
+
+					vst1q_u8( &d[x*4+ 0], vreinterpretq_u8_u32( cv ) );
+					vst1q_u8( &d[x*4+16], vreinterpretq_u8_u32( cv ) );
+					continue;
+				}
+
+				uint8x8x4_t	dv	= vld4_u8( &d[x*4] );
+				uint16x8_t	a	= vmovl_u8( mv );
+				uint16x8_t	ia;
+
+				a	= vsraq_n_u16( a, a, 7 );
+				ia	= vsubq_u16( c256, a );
+
+				dv.val[0]	= BlendA8_NEON( dv.val[0], c0, a, ia );
+				dv.val[1]	= BlendA8_NEON( dv.val[1], c1, a, ia );
+				dv.val[2]	= BlendA8_NEON( dv.val[2], c2, a, ia );
+				dv.val[3]	= BlendA8_NEON( dv.val[3], c3, a, ia );
+
+				vst4_u8( &d[x*4], dv );
+			}
+#elif IMAGE_BLEND_SSE2
+			__m128i	zero	= _mm_setzero_si128();
+			__m128i	ff		= _mm_set1_epi8( -1 );
+			__m128i	cv		= _mm_set1_epi32( (int)color );
+			__m128i	c		= _mm_unpacklo_epi8( cv, zero );		// b,g,r,a,b,g,r,a
+
+			for( ; isOpaqueColor && ((x+8) <= cx); x += 8 )
+			{
+				__m128i	mv	= _mm_loadl_epi64( (const __m128i*)&m[x] );
+
+				if( 0xFF == (0xFF & _mm_movemask_epi8( _mm_cmpeq_epi8( mv, zero ) )) )
+				{
+					continue;
+				}
+
+				if( 0xFF == (0xFF & _mm_movemask_epi8( _mm_cmpeq_epi8( mv, ff ) )) )
+				{
+					_mm_storeu_si128( (__m128i*)&d[x*4+ 0], cv );
+					_mm_storeu_si128( (__m128i*)&d[x*4+16], cv );
+					continue;
+				}
+
+				__m128i	a	= _mm_unpacklo_epi8( mv, zero );
+				__m128i	a01, a23, a45, a67;
+
+				a	= _mm_add_epi16( a, _mm_srli_epi16( a, 7 ) );
+				SplatA8x4_SSE2( a, a01, a23, a45, a67 );
+
+				__m128i	d0	= _mm_loadu_si128( (const __m128i*)&d[x*4+ 0] );
+				__m128i	d1	= _mm_loadu_si128( (const __m128i*)&d[x*4+16] );
+
+				d0	= _mm_packus_epi16(
+						BlendA8_SSE2( _mm_unpacklo_epi8( d0, zero ), c, a01 ),
+						BlendA8_SSE2( _mm_unpackhi_epi8( d0, zero ), c, a23 ) );
+				d1	= _mm_packus_epi16(
+						BlendA8_SSE2( _mm_unpacklo_epi8( d1, zero ), c, a45 ),
+						BlendA8_SSE2( _mm_unpackhi_epi8( d1, zero ), c, a67 ) );
+
+				_mm_storeu_si128( (__m128i*)&d[x*4+ 0], d0 );
+				_mm_storeu_si128( (__m128i*)&d[x*4+16], d1 );
+			}
+#endif
+
+			A8overBGRA8888_Line( &m[x], color, &d[x*4], cx - x );
+		}
+	}
+};
+
+#endif	// __IMG_BLEND_H_INCLUDED__
@@ -109,7 +109,7 @@ namespace ImageConvert
 	
 				d[ 0]	= (0x000000FF & (s0 >> 16)) | (0x0000FF00 & (s0 >>  0))  | (0x00FF0000 & (s0 << 16)) | (0xFF000000 & (s1 <<  8));
 				d[ 1]	= (0x000000FF & (s1 >>  8)) | (0x0000FF00 & (s1 <<  8))  | (0x00FF0000 & (s2 <<  0)) | (0xFF000000 & (s2 << 16));
-				d[ 2]	= (0x000000FF & (s2 >>  0)) | (0x0000FF00 & (s3 >>  8))  | (0x00FF0000 & (s3 <<  8)) | (0xFF000000 & (s1 << 24));
+				d[ 2]	= (0x000000FF & (s2 >>  0)) | (0x0000FF00 & (s3 >>  8))  | (0x00FF0000 & (s3 <<  8)) | (0xFF000000 & (s3 << 24));
 			}
 	
 			for( ; x < cx; x++ )
@@ -286,6 +286,65 @@ namespace ImageConvert
 			}
 		}
 	}
+
+	// RGB565 (MSB first, as BGRA8888toRGB565) -> RGB565L (little endian, fbdev)
+	void	RGB565toRGB565L( const uint8_t* pSrcImage, int nSrcStride, int cx, int cy, uint8_t * pDstImage, int nDstStride )
+	{
+		for( int y = 0; y < cy; y++ )
+		{
+			const uint8_t*	pSrcLine	= GetLine(pSrcImage,nSrcStride,y);
+			uint8_t*		pDstLine	= GetLine(pDstImage,nDstStride,y);
+
+			for( int x = 0; x < cx; x++ )
+			{
+				pDstLine[x*2+0]	= pSrcLine[x*2+1];
+				pDstLine[x*2+1]	= pSrcLine[x*2+0];
+			}
+		}
+	}
+
+	void	RGB565toRGB888( const uint8_t* pSrcImage, int nSrcStride, int cx, int cy, uint8_t * pDstImage, int nDstStride )
+	{
+		for( int y = 0; y < cy; y++ )
+		{
+			const uint8_t*	pSrcLine	= GetLine(pSrcImage,nSrcStride,y);
+			uint8_t*		pDstLine	= GetLine(pDstImage,nDstStride,y);
+
+			for( int x = 0; x < cx; x++ )
+			{
+				uint32_t	p	= (pSrcLine[x*2+0] << 8) | pSrcLine[x*2+1];
+				uint32_t	r	= (p >> 11);
+				uint32_t	g	= (p >>  5) & 0x3F;
+				uint32_t	b	= (p >>  0) & 0x1F;
+
+				pDstLine[x*3+0]	= (r << 3) | (r >> 2);
+				pDstLine[x*3+1]	= (g << 2) | (g >> 4);
+				pDstLine[x*3+2]	= (b << 3) | (b >> 2);
+			}
+		}
+	}
+
+	void	RGB565toBGRA8888( const uint8_t* pSrcImage, int nSrcStride, int cx, int cy, uint8_t * pDstImage, int nDstStride )
+	{
+		for( int y = 0; y < cy; y++ )
+		{
+			const uint8_t*	pSrcLine	= GetLine(pSrcImage,nSrcStride,y);
+			uint8_t*		pDstLine	= GetLine(pDstImage,nDstStride,y);
+
+			for( int x = 0; x < cx; x++ )
+			{
+				uint32_t	p	= (pSrcLine[x*2+0] << 8) | pSrcLine[x*2+1];
+				uint32_t	r	= (p >> 11);
+				uint32_t	g	= (p >>  5) & 0x3F;
+				uint32_t	b	= (p >>  0) & 0x1F;
+
+				pDstLine[x*4+0]	= (b << 3) | (b >> 2);
+				pDstLine[x*4+1]	= (g << 2) | (g >> 4);
+				pDstLine[x*4+2]	= (r << 3) | (r >> 2);
+				pDstLine[x*4+3]	= 0xFF;
+			}
+		}
+	}
 };
 
 #endif	// __IMG_CONV_H_INCLUDED__
\ No newline at end of file
@@ -11,12 +11,143 @@
 #include <ft2build.h>
 #include FT_FREETYPE_H
 #include FT_STROKER_H
+#include FT_SIZES_H
 
+#include <stdio.h>
 #include <stdint.h>
+#include <string.h>
+#include <unistd.h>
 #include <string>
+#include <vector>
+#include <mutex>
+#include "img_blend.h"
+#include "img_glyph_cache.h"
+#include "img_glyph_disk_cache.h"
+#include "img_font_registry.h"
 //#include <locale>
 //#include <codecvt>
 
+//	Streaming UTF-8 decoder, no allocation.
+//	A truncated sequence at the end gives '?', stray bytes are skipped,
+//	continuation bytes are not checked. (as GetUnicode32fromUTF8 always did)
+class	Utf8Iterator
+{
+public:
+	Utf8Iterator( const char* str )
+	{
+		m_pCur	= str;
+		m_pEnd	= str + strlen( str );
+	}
+
+	Utf8Iterator( const char* str, size_t len )
+	{
+		m_pCur	= str;
+		m_pEnd	= str + len;
+	}
+
+	// false at the end of the string.
+	bool	Next( uint32_t& code )
+	{
+		while( m_pCur < m_pEnd )
+		{
+			uint32_t	c	= (uint8_t)*m_pCur;
+			int			n;
+
+			if( 0 == (0x80 & c) )
+			{
+				m_pCur++;
+				code	= c;
+				return	true;
+			}
+			else if( 0xC0 == (0xE0 & c) )
+			{
+				n	= 1;
+				c	&= 0x1F;
+			}
+			else if( 0xE0 == (0xF0 & c) )
+			{
+				n	= 2;
+				c	&= 0x0F;
+			}
+			else if( 0xF0 == (0xF8 & c) )
+			{
+				n	= 3;
+				c	&= 0x07;
+			}
+			else
+			{
+				m_pCur++;
+				continue;
+			}
+
+			if( (m_pEnd - m_pCur) <= n )
+			{
+				m_pCur	= m_pEnd;
+				code	= '?';
+				return	true;
+			}
+
+			for( int i = 1; i <= n; i++ )
+			{
+				c	= (c << 6) | (0x3F & m_pCur[i]);
+			}
+
+			m_pCur	+= n + 1;
+			code	= c;
+			return	true;
+		}
+
+		return	false;
+	}
+
+protected:
+	const char*		m_pCur;
+	const char*		m_pEnd;
+};
+
+
+//	Laid out text of one ImageFont. (ImageFont::Layout)
+//	Holds the decoded glyphs, their pen positions and the bounding box, so a
+//	string is measured once and drawn any number of times.
+class	TextRun
+{
+public:
+	struct Item
+	{
+		uint32_t	code;
+		FT_Vector	pen;		// 26.6, relative to the draw position
+	};
+
+public:
+	TextRun()
+	{
+		Clear();
+	}
+
+	void	Clear()
+	{
+		items.clear();
+
+		left	= 0;
+		top		= 0;
+		right	= 0;
+		bottom	= 0;
+	}
+
+public:
+	std::vector<Item>	items;
+	int					left;		// bounding box, as ImageFont::CalcRect()
+	int					top;
+	int					right;
+	int					bottom;
+};
+
+
+//	Not reentrant: an ImageFont is used by one thread at a time. The
+//	const char* / u32string overloads lay out into m_tRun and GetGlyph()
+//	returns m_tPlaced, both per font. Threads drawing at once each need
+//	their own ImageFont; fonts of the same file share the face and its lock,
+//	and all fonts share the glyph cache under GlyphCache::GetMutex().
 class	ImageFont
 {
 public:
@@ -27,20 +158,30 @@ public:
 
 		// initialize member var.
 		m_nBaseline		= height;
-		m_piLibrary		= NULL;
 		m_piFace		= NULL;
+		m_piSize		= NULL;
+		m_pCache		= &GlyphCache::GetDefault();
+		m_pDiskCache	= &GlyphDiskCache::GetDefault();
+		m_isMono		= false;
 
-		error	= FT_Init_FreeType( &m_piLibrary );
-		if( 0 != error )
-		{
-			throw	"ERROR: FT_Init_FreeType()";
-		}
+		// shared face, own size.
+		m_piFace	= FontRegistry::GetInstance().Acquire( filename );
+		m_nFileHash	= FontRegistry::GetInstance().GetFileHash( m_piFace );
+		m_pFaceLock	= FontRegistry::GetInstance().GetFaceMutex( m_piFace );
+		m_pCoverage	= FontRegistry::GetInstance().GetCoverage( m_piFace );
 
-		error	= FT_New_Face( m_piLibrary, filename, 0, &m_piFace );
+		// the last Release() frees the lock, leave it first.
+		std::unique_lock<std::mutex>	lock( *m_pFaceLock );
+
+		error	= FT_New_Size( m_piFace, &m_piSize );
 		if( 0 != error )
 		{
-			throw	"ERROR: FT_New_Face";
+			lock.unlock();
+			FontRegistry::GetInstance().Release( m_piFace );
+			throw	"ERROR: FT_New_Size()";
 		}
+
+		FT_Activate_Size( m_piSize );
 		
 	    tReqSize.type			= FT_SIZE_REQUEST_TYPE_NOMINAL;
 	    tReqSize.width			= 0;
@@ -63,6 +204,9 @@ public:
 		error	= FT_Request_Size( m_piFace, &tReqSize );
 		if( 0 != error )
 		{
+			FT_Done_Size( m_piSize );
+			lock.unlock();
+			FontRegistry::GetInstance().Release( m_piFace );
 			throw	"ERROR: FT_Request_Size()";
 		}
 
@@ -114,311 +258,638 @@ public:
 
 	~ImageFont()
 	{
-		FT_Done_Face( m_piFace );
-		FT_Done_FreeType( m_piLibrary );
+		for( auto& face : m_iFallbacks )
+		{
+			FontRegistry::GetInstance().ReleaseSize( face.piFace, face.piSize );
+			ReleaseFace( face.piFace, NULL, face.pLock );
+		}
+
+		ReleaseFace( m_piFace, m_piSize, m_pFaceLock );
+	}
+
+	// Face for the codepoints this font does not have, tried in the order added.
+	// Drawn at the same em size and baseline, the size is shared with the other
+	// fonts of that ppem. false if the file is missing, is not a font or can
+	// not be sized.
+	bool	AddFallback( const char* filename )
+	{
+		Face		face;
+
+		if( 0 != access( filename, R_OK ) )
+		{
+			return	false;
+		}
+
+		try
+		{
+			face.piFace		= FontRegistry::GetInstance().Acquire( filename );
+		}
+		catch( const char* pszError )
+		{
+			printf( "WARNING: ImageFont::AddFallback( %s ) %s\n", filename, pszError );
+			return	false;
+		}
+
+		face.piSize		= FontRegistry::GetInstance().AcquireSize( face.piFace, m_piSize->metrics.x_ppem, m_piSize->metrics.y_ppem );
+		face.pLock		= FontRegistry::GetInstance().GetFaceMutex( face.piFace );
+		face.nFileHash	= FontRegistry::GetInstance().GetFileHash( face.piFace );
+		face.pCoverage	= FontRegistry::GetInstance().GetCoverage( face.piFace );
+
+		if( NULL == face.piSize )
+		{
+			printf( "WARNING: ImageFont::AddFallback( %s ) can not be sized.\n", filename );
+			FontRegistry::GetInstance().Release( face.piFace );
+			return	false;
+		}
+
+		m_iFallbacks.push_back( face );
+		return	true;
 	}
 	
 	static	std::u32string	GetUnicode32fromUTF8( const char * str )
 	{
-		std::string		utf8	= str;
+		Utf8Iterator	it( str );
 		std::u32string	u32str;
+		uint32_t		code;
 
-		for( size_t i = 0; i < utf8.size(); i++ )
+		while( it.Next( code ) )
 		{
-			uint32_t	c	= (uint32_t)utf8[i];
+			u32str.push_back( code );
+		}
 
-			if( 0 == (0x80 & c) )
-			{
-				u32str.push_back( c );
-			}
-			else if( 0xC0 == (0xE0 & c) )
+		return	u32str;
+//		return	std::wstring_convert<std::codecvt_utf8<char32_t>, char32_t>().from_bytes(str);
+	}
+
+	// str: UTF-8. The const char* overloads decode inline and reuse the run of
+	// this font (m_tRun), so measuring and drawing do not allocate once warmed
+	// up. To keep a layout, pass your own TextRun to Layout() and DrawText*().
+	int	CalcRect( int& left, int& top, int& right, int& bottom, const char* str )
+	{
+		return	CalcRect( left, top, right, bottom, str, strlen( str ) );
+	}
+
+	int	CalcRect( int& left, int& top, int& right, int& bottom, const char* str, size_t len )
+	{
+		Layout( m_tRun, str, len );
+
+		left	= m_tRun.left;
+		top		= m_tRun.top;
+		right	= m_tRun.right;
+		bottom	= m_tRun.bottom;
+
+		return	0;
+	}
+
+	int	CalcRect( int& left, int& top, int& right, int& bottom, const std::u32string& u32str )
+	{
+		Layout( m_tRun, u32str );
+
+		left	= m_tRun.left;
+		top		= m_tRun.top;
+		right	= m_tRun.right;
+		bottom	= m_tRun.bottom;
+
+		return	0;
+	}
+
+	TextRun	Layout( const char* str )
+	{
+		TextRun		run;
+
+		Layout( run, str );
+		return	run;
+	}
+
+	TextRun	Layout( const std::u32string& u32str )
+	{
+		TextRun		run;
+
+		Layout( run, u32str );
+		return	run;
+	}
+
+	// Decode, place and rasterise (into the glyph cache) once.
+	// run can be reused to keep its capacity.
+	void	Layout( TextRun& run, const char* str )
+	{
+		Layout( run, str, strlen( str ) );
+	}
+
+	void	Layout( TextRun& run, const char* str, size_t len )
+	{
+		Utf8Iterator	it( str, len );
+		FT_Vector		pen		= { 0, 0 };
+		uint32_t		code;
+
+		run.Clear();
+
+		while( it.Next( code ) )
+		{
+			Place( run, code, pen );
+		}
+	}
+
+	void	Layout( TextRun& run, const std::u32string& u32str )
+	{
+		FT_Vector		pen		= { 0, 0 };
+
+		run.Clear();
+
+		for( size_t i = 0; i < u32str.size(); i++ )
+		{
+			Place( run, u32str[i], pen );
+		}
+	}
+	
+	int DrawTextGRAY( int x, int y, const char* str, uint8_t color, uint8_t * image, int stride, int cx, int cy )
+	{
+		Layout( m_tRun, str );
+		return	DrawTextGRAY( x, y, m_tRun, color, image, stride, cx, cy );
+	}
+
+	int DrawTextGRAY( int x, int y, const std::u32string& u32str, uint8_t color, uint8_t * image, int stride, int cx, int cy )
+	{
+		Layout( m_tRun, u32str );
+		return	DrawTextGRAY( x, y, m_tRun, color, image, stride, cx, cy );
+	}
+
+	// run: Layout() of this font. Glyphs are blended from the cache, no FreeType call unless evicted.
+	int DrawTextGRAY( int x, int y, const TextRun& run, uint8_t color, uint8_t * image, int stride, int cx, int cy )
+	{
+		for( auto& item : run.items )
+		{
+			DrawGlyph( item.code, item.pen, [&]( const GlyphCache::Glyph& glyph )
 			{
-				if( (i+1) < utf8.size() )
-				{
-					c	=  (uint32_t)(0x1F & utf8[i+0]) << 6;
-					c	|= (uint32_t)(0x3F & utf8[i+1]) << 0;
-				}
-				else
+				int	bmp_cy	= glyph.rows;
+				int	pos_y	= y + m_nBaseline - glyph.top;
+				int	rs		= 0 <= pos_y ? 0 : -pos_y;
+				int	re		= (pos_y + bmp_cy) <= cy ? bmp_cy : (cy - pos_y);
+
+				int	bmp_cx	= glyph.width;
+				int	pos_x	= x + glyph.left;
+				int	cs		= 0 <= pos_x ? 0 : -pos_x;
+				int	ce		= (pos_x + bmp_cx) <= cx ? bmp_cx : (cx - pos_x);
+
+				if( (rs < re) && (cs < ce) )
 				{
-					c	= '?';
+					ImageBlend::A8overGRAY8(
+						&glyph.bitmap[ bmp_cx * rs + cs ], bmp_cx,
+						ce - cs, re - rs, color,
+						&image[ stride * (pos_y + rs) + pos_x + cs ], stride );
 				}
+			} );
+		}
+		
+		return	0;
+	}
 
-				i	+= 1;
-				u32str.push_back( c );
-			}
-			else if( 0xE0 == (0xF0 & c) )
+	int DrawTextBGRA( int x, int y, const char* str, uint32_t color, uint8_t * image, int stride, int cx, int cy )
+	{
+		Layout( m_tRun, str );
+		return	DrawTextBGRA( x, y, m_tRun, color, image, stride, cx, cy );
+	}
+	
+	int DrawTextBGRA( int x, int y, const std::u32string& u32str, uint32_t color, uint8_t * image, int stride, int cx, int cy )
+	{
+		Layout( m_tRun, u32str );
+		return	DrawTextBGRA( x, y, m_tRun, color, image, stride, cx, cy );
+	}
+
+	int DrawTextBGRA( int x, int y, const TextRun& run, uint32_t color, uint8_t * image, int stride, int cx, int cy )
+	{
+		for( auto& item : run.items )
+		{
+			DrawGlyph( item.code, item.pen, [&]( const GlyphCache::Glyph& glyph )
 			{
-				if( (i+2) < utf8.size() )
-				{
-					c	=  (uint32_t)(0x0F & utf8[i+0]) << 12;
-					c	|= (uint32_t)(0x3F & utf8[i+1]) << 6;
-					c	|= (uint32_t)(0x3F & utf8[i+2]) << 0;
-				}
-				else
+				int	bmp_cy	= glyph.rows;
+				int	pos_y	= y + m_nBaseline - glyph.top;
+				int	rs		= 0 <= pos_y ? 0 : -pos_y;
+				int	re		= (pos_y + bmp_cy) <= cy ? bmp_cy : (cy - pos_y);
+
+				int	bmp_cx	= glyph.width;
+				int	pos_x	= x + glyph.left;
+				int	cs		= 0 <= pos_x ? 0 : -pos_x;
+				int	ce		= (pos_x + bmp_cx) <= cx ? bmp_cx : (cx - pos_x);
+
+				if( (rs < re) && (cs < ce) )
 				{
-					c	= '?';
+					ImageBlend::A8overBGRA8888(
+						&glyph.bitmap[ bmp_cx * rs + cs ], bmp_cx,
+						ce - cs, re - rs, color,
+						&image[ stride * (pos_y + rs) + (pos_x + cs) * 4 ], stride );
 				}
+			} );
+		}
+		
+		return	0;
+	}
 
-				i	+= 2;
-				u32str.push_back( c );
-			}
-			else if( 0xF0 == (0xF8 & c) )
+	int DrawTextRGB565( int x, int y, const char* str, uint32_t color, uint8_t * image, int stride, int cx, int cy )
+	{
+		Layout( m_tRun, str );
+		return	DrawTextRGB565( x, y, m_tRun, color, image, stride, cx, cy );
+	}
+
+	int DrawTextRGB565( int x, int y, const std::u32string& u32str, uint32_t color, uint8_t * image, int stride, int cx, int cy )
+	{
+		Layout( m_tRun, u32str );
+		return	DrawTextRGB565( x, y, m_tRun, color, image, stride, cx, cy );
+	}
+
+	// image: RGB565 (MSB first, as the panels), color: ARGB.
+	int DrawTextRGB565( int x, int y, const TextRun& run, uint32_t color, uint8_t * image, int stride, int cx, int cy )
+	{
+		for( auto& item : run.items )
+		{
+			DrawGlyph( item.code, item.pen, [&]( const GlyphCache::Glyph& glyph )
 			{
-				if( (i+3) < utf8.size() )
-				{
-					c	=  (uint32_t)(0x07 & utf8[i+0]) << 18;
-					c	|= (uint32_t)(0x3F & utf8[i+1]) << 12;
-					c	|= (uint32_t)(0x3F & utf8[i+2]) << 6;
-					c	|= (uint32_t)(0x3F & utf8[i+3]) << 0;
-				}
-				else
+				int	bmp_cy	= glyph.rows;
+				int	pos_y	= y + m_nBaseline - glyph.top;
+				int	rs		= 0 <= pos_y ? 0 : -pos_y;
+				int	re		= (pos_y + bmp_cy) <= cy ? bmp_cy : (cy - pos_y);
+
+				int	bmp_cx	= glyph.width;
+				int	pos_x	= x + glyph.left;
+				int	cs		= 0 <= pos_x ? 0 : -pos_x;
+				int	ce		= (pos_x + bmp_cx) <= cx ? bmp_cx : (cx - pos_x);
+
+				if( (rs < re) && (cs < ce) )
 				{
-					c	= '?';
+					ImageBlend::A8overRGB565(
+						&glyph.bitmap[ bmp_cx * rs + cs ], bmp_cx,
+						ce - cs, re - rs, color,
+						&image[ stride * (pos_y + rs) + (pos_x + cs) * 2 ], stride );
 				}
-				
-				i	+= 3;
-				u32str.push_back( c );
-			}
+			} );
 		}
-		return	u32str;
-//		return	std::wstring_convert<std::codecvt_utf8<char32_t>, char32_t>().from_bytes(str);
+		
+		return	0;
 	}
 
-	int	CalcRect( int& left, int& top, int& right, int& bottom, const char* str )
+	int DrawText1BPP( int x, int y, const char* str, uint8_t color, uint8_t * image, int stride, int cx, int cy )
 	{
-		return	CalcRect( left, top, right, bottom, GetUnicode32fromUTF8( str ) );
+		Layout( m_tRun, str );
+		return	DrawText1BPP( x, y, m_tRun, color, image, stride, cx, cy );
 	}
 
-	int	CalcRect( int& left, int& top, int& right, int& bottom, const std::u32string& u32str )
+	int DrawText1BPP( int x, int y, const std::u32string& u32str, uint8_t color, uint8_t * image, int stride, int cx, int cy )
 	{
-		FT_Error		error;
-		FT_GlyphSlot	slot	= m_piFace->glyph;
-		FT_Matrix		matrix	= { 1 << 16, 0, 0, 1 << 16 };
-		FT_Vector		pen		= { 0, 0 };
-		bool			isFirst	= true;
+		Layout( m_tRun, u32str );
+		return	DrawText1BPP( x, y, m_tRun, color, image, stride, cx, cy );
+	}
 
-		left	= 0;
-		top		= 0;
-		right	= 0;
-		bottom	= 0;
+	// image: 1bpp rows of ImageBitPack (bit n = pixel n). Coverage >= 128 sets
+	// the pixel to color >= 128. Use SetMonoRendering( true ) for crisp glyphs.
+	int DrawText1BPP( int x, int y, const TextRun& run, uint8_t color, uint8_t * image, int stride, int cx, int cy )
+	{
+		uint8_t	on	= 128 <= color ? 0xFF : 0x00;
 
-		for( size_t i = 0; i < u32str.size(); i++ )
+		for( auto& item : run.items )
 		{
-			switch( u32str[i] )
+			DrawGlyph( item.code, item.pen, [&]( const GlyphCache::Glyph& glyph )
 			{
-			case '\r':
-				break;
-
-			case '\t':
-				pen.x	+= m_piFace->size->metrics.max_advance * 4;
-				pen.x	-= pen.x % (m_piFace->size->metrics.max_advance * 4);
-				break;
-				
-			case '\n':
-				pen.x	= 0;
-				pen.y	-= m_piFace->size->metrics.height;
-				break;
-			
-			default:
-				FT_Set_Transform( m_piFace, &matrix, &pen );
-	
-				error	= FT_Load_Char( m_piFace, u32str[i], FT_LOAD_RENDER );
-				if( 0 == error )
+				int	bmp_cy	= glyph.rows;
+				int	pos_y	= y + m_nBaseline - glyph.top;
+				int	rs		= 0 <= pos_y ? 0 : -pos_y;
+				int	re		= (pos_y + bmp_cy) <= cy ? bmp_cy : (cy - pos_y);
+
+				int	bmp_cx	= glyph.width;
+				int	pos_x	= x + glyph.left;
+				int	cs		= 0 <= pos_x ? 0 : -pos_x;
+				int	ce		= (pos_x + bmp_cx) <= cx ? bmp_cx : (cx - pos_x);
+
+				for( int r = rs; r < re; r++ )
 				{
-					int	l	= slot->bitmap_left;
-					int	r	= slot->bitmap_left + slot->bitmap.width;
-					int	t	= m_nBaseline - slot->bitmap_top;
-					int	b	= m_nBaseline - slot->bitmap_top + slot->bitmap.rows;
-	
-					if( !isFirst )
-					{
-						left	= left   < l ? left : l;
-						top		= top    < t ? top  : t;
-						right	= right  < r ? r : right;
-						bottom	= bottom < b ? b : bottom;
-					}
-					else
+					const uint8_t*	m	= &glyph.bitmap[ bmp_cx * r ];
+					uint8_t*		d	= &image[ stride * (pos_y + r) ];
+
+					for( int c = cs; c < ce; c++ )
 					{
-						left	= l;
-						top		= t;
-						right	= r;
-						bottom	= b;
-						isFirst	= false;
+						if( 128 <= m[c] )
+						{
+							int		px	= pos_x + c;
+							uint8_t	bit	= 1 << (px & 7);
+
+							d[ px / 8 ]	= (d[ px / 8 ] & ~bit) | (on & bit);
+						}
 					}
-	
-					pen.x	+= slot->advance.x;
-					pen.y	+= slot->advance.y;
 				}
-				break;
-			}
+			} );
 		}
-
+		
 		return	0;
 	}
-	
-	int DrawTextGRAY( int x, int y, const char* str, uint8_t color, uint8_t * image, int stride, int cx, int cy )
+
+	// Glyph of code drawn at pen, as DrawText*() places it. (left / top include pen)
+	// NULL if the glyph can not be loaded. Valid until the next call on this font,
+	// the bitmap is a copy.
+	const GlyphCache::Glyph*	GetGlyph( uint32_t code, const FT_Vector& pen )
 	{
-		return	DrawTextGRAY( x, y, GetUnicode32fromUTF8(str), color, image, stride, cx, cy );
+		return	LoadGlyph( code, pen );
 	}
 
-	int DrawTextGRAY( int x, int y, const std::u32string& u32str, uint8_t color, uint8_t * image, int stride, int cx, int cy )
+	// Row of the baseline when drawn at y = 0.
+	int		GetBaseline() const
 	{
-		FT_Error		error;
-		FT_GlyphSlot	slot	= m_piFace->glyph;
-		FT_Matrix		matrix	= { 1 << 16, 0, 0, 1 << 16 };
-		FT_Vector		pen		= { 0, 0 };
+		return	m_nBaseline;
+	}
 
-		for( size_t i = 0; i < u32str.size(); i++ )
+	// 1bpp displays: hint and render for FT_RENDER_MODE_MONO, coverage is 0x00 / 0xFF.
+	// Metrics follow the mono hinting too, so set it before Layout().
+	void	SetMonoRendering( bool isMono )
+	{
+		m_isMono	= isMono;
+	}
+
+	GlyphCache&	GetGlyphCache()
+	{
+		return	*m_pCache;
+	}
+
+	// Default: GlyphCache::GetDefault(), shared by all fonts and threads.
+	// Entries in the default cache are left to the other fonts of the face.
+	void	SetGlyphCache( GlyphCache* pCache )
+	{
+		if( m_pCache != &GlyphCache::GetDefault() )
 		{
-			switch( u32str[i] )
+			std::lock_guard<std::mutex>	lock( m_pCache->GetMutex() );
+
+			m_pCache->Purge( m_piFace );
+
+			for( auto& face : m_iFallbacks )
 			{
-			case '\r':
-				break;
-
-			case '\t':
-				pen.x	+= m_piFace->size->metrics.max_advance * 4;
-				pen.x	-= pen.x % (m_piFace->size->metrics.max_advance * 4);
-				break;
-
-			case '\n':
-				pen.x	= 0;
-				pen.y	-= m_piFace->size->metrics.height;
-				break;
+				m_pCache->Purge( face.piFace );
+			}
+		}
+
+		m_pCache	= pCache;
+	}
+
+	// Default: GlyphDiskCache::GetDefault(), used once opened. NULL: none.
+	void	SetDiskCache( GlyphDiskCache* pDiskCache )
+	{
+		m_pDiskCache	= pDiskCache;
+	}
+
+protected:
+	struct Face
+	{
+		FT_Face					piFace;		// shared, FontRegistry
+		FT_Size					piSize;		// shared, FontRegistry::AcquireSize()
+		std::mutex*				pLock;
+		uint64_t				nFileHash;
+		const CodepointSet*		pCoverage;
+	};
+
+protected:
+	// piSize: own size, NULL if shared. (AcquireSize())
+	void	ReleaseFace( FT_Face piFace, FT_Size piSize, std::mutex* pLock )
+	{
+		if( NULL != piSize )
+		{
+			std::lock_guard<std::mutex>	lock( *pLock );
+
+			FT_Done_Size( piSize );
+		}
+
+		// entries of a closed face must not match a new face at the same address.
+		// (a private cache does not know the other users of the face)
+		if( FontRegistry::GetInstance().Release( piFace ) || (m_pCache != &GlyphCache::GetDefault()) )
+		{
+			std::lock_guard<std::mutex>	lock( m_pCache->GetMutex() );
+
+			m_pCache->Purge( piFace );
+		}
+	}
+
+	// Append code at pen to run and advance pen. Controls move the pen only.
+	void	Place( TextRun& run, uint32_t code, FT_Vector& pen )
+	{
+		switch( code )
+		{
+		case '\r':
+			break;
+
+		case '\t':
+			pen.x	+= m_piSize->metrics.max_advance * 4;
+			pen.x	-= pen.x % (m_piSize->metrics.max_advance * 4);
+			break;
 			
-			default:
-				FT_Set_Transform( m_piFace, &matrix, &pen );
+		case '\n':
+			pen.x	= 0;
+			pen.y	-= m_piSize->metrics.height;
+			break;
+		
+		default:
+			if( const GlyphCache::Glyph* glyph = LoadGlyph( code, pen, false ) )
+			{
+				TextRun::Item	item	= { code, pen };
+
+				int	l	= glyph->left;
+				int	r	= glyph->left + glyph->width;
+				int	t	= m_nBaseline - glyph->top;
+				int	b	= m_nBaseline - glyph->top + glyph->rows;
 
-				error	= FT_Load_Char( m_piFace, u32str[i], FT_LOAD_RENDER );
-				if( 0 == error )
+				if( !run.items.empty() )
 				{
-					int	bmp_cy	= slot->bitmap.rows;
-					int	pos_y	= y + m_nBaseline - slot->bitmap_top;
-					int	rs		= 0 <= pos_y ? 0 : -pos_y;
-					int	re		= (pos_y + bmp_cy) <= cy ? bmp_cy : (cy - pos_y);
-	
-					int	bmp_cx	= slot->bitmap.width;
-					int	pos_x	= x + slot->bitmap_left;
-					int	cs		= 0 <= pos_x ? 0 : -pos_x;
-					int	ce		= (pos_x + bmp_cx) <= cx ? bmp_cx : (cx - pos_x);
-	
-					for( int r = rs; r < re; r++ )
-					{
-						uint8_t *	src_line	= &slot->bitmap.buffer[ bmp_cx * r ];
-						uint8_t *	dst_line	= &image[ stride * (pos_y + r) + pos_x ];
-						int 		c			= cs;
-	
-						for( ; c < ce; c++ )
-						{
-							int32_t	a0	= src_line[c+0];
-	
-							if( 0 < a0 )
-							{
-								int32_t	d0	= dst_line[c+0];
-								a0	+= a0 >> 7;
-								dst_line[c+0] = (uint8_t)( d0 + (((color - d0) * a0) >> 8) );
-							}
-						}
-					}
-	
-					pen.x	+= slot->advance.x;
-					pen.y	+= slot->advance.y;
+					run.left	= run.left   < l ? run.left : l;
+					run.top		= run.top    < t ? run.top  : t;
+					run.right	= run.right  < r ? r : run.right;
+					run.bottom	= run.bottom < b ? b : run.bottom;
 				}
-				break;
+				else
+				{
+					run.left	= l;
+					run.top		= t;
+					run.right	= r;
+					run.bottom	= b;
+				}
+
+				run.items.push_back( item );
+
+				pen.x	+= glyph->advance.x;
+				pen.y	+= glyph->advance.y;
 			}
+			break;
 		}
-		
-		return	0;
 	}
 
-	int DrawTextBGRA( int x, int y, const char* str, uint32_t color, uint8_t * image, int stride, int cx, int cy )
+	// Rendered glyph at pen, positioned like FT_Set_Transform( pen ) + FT_Load_Char( FT_LOAD_RENDER ).
+	// Only the sub-pixel phase of pen is rendered, the integer part is added
+	// to left / top. draw( const GlyphCache::Glyph& ) runs under the cache lock
+	// and reads the bitmap in the cache, keep it to the blend of one glyph.
+	// false if the glyph can not be loaded.
+	template<class Draw>
+	bool	DrawGlyph( uint32_t code, const FT_Vector& pen, Draw draw )
+	{
+		FT_Face						piFace		= m_piFace;
+		FT_Size						piSize		= m_piSize;
+		std::mutex*					pLock		= m_pFaceLock;
+		uint64_t					nFileHash	= m_nFileHash;
+
+		// first face that has code, by its cmap. none: this font. (.notdef)
+		if( !m_iFallbacks.empty() && !m_pCoverage->Has( code ) )
+		{
+			for( auto& face : m_iFallbacks )
+			{
+				if( face.pCoverage->Has( code ) )
+				{
+					piFace		= face.piFace;
+					piSize		= face.piSize;
+					pLock		= face.pLock;
+					nFileHash	= face.nFileHash;
+					break;
+				}
+			}
+		}
+
+		FT_Render_Mode				mode	= m_isMono ? FT_RENDER_MODE_MONO : FT_RENDER_MODE_NORMAL;
+		GlyphCache::Key				key		= { piFace, piSize->metrics.x_scale, piSize->metrics.y_scale, code, (uint16_t)(((pen.y & 63) << 6) | (pen.x & 63)), (uint16_t)mode };
+		GlyphDiskCache::Key			disk	= { nFileHash, key.x_scale, key.y_scale, key.code, key.phase, key.mode };
+		bool						isDisk	= (NULL != m_pDiskCache) && m_pDiskCache->IsOpen();
+
+		{
+			std::lock_guard<std::mutex>	lock( m_pCache->GetMutex() );
+			const GlyphCache::Glyph*	glyph	= m_pCache->Find( key );
+
+			if( (NULL == glyph) && isDisk )
+			{
+				GlyphCache::Glyph	stored;
+
+				if( m_pDiskCache->Find( disk, stored ) )
+				{
+					glyph	= m_pCache->Insert( key, stored );
+				}
+			}
+
+			if( NULL != glyph )
+			{
+				return	DrawPlaced( *glyph, pen, draw );
+			}
+		}
+
+		FT_Matrix	matrix	= { 1 << 16, 0, 0, 1 << 16 };
+		FT_Vector	phase	= { pen.x & 63, pen.y & 63 };
+		FT_Error	error;
+
+		// the face is shared, also with other threads. select our size.
+		std::lock_guard<std::mutex>	lock( *pLock );
+
+		FT_Activate_Size( piSize );
+		FT_Set_Transform( piFace, &matrix, &phase );
+
+		error	= FT_Load_Char( piFace, code, FT_LOAD_RENDER | FT_LOAD_TARGET_( mode ) );
+
+		{
+			std::lock_guard<std::mutex>	lockCache( m_pCache->GetMutex() );
+			const GlyphCache::Glyph*	glyph	= m_pCache->Insert( key, 0 == error ? piFace->glyph : NULL );
+
+			if( NULL != glyph )
+			{
+				if( isDisk )
+				{
+					m_pDiskCache->Append( disk, *glyph );
+				}
+
+				return	DrawPlaced( *glyph, pen, draw );
+			}
+		}
+
+		// not cacheable, use a copy of the slot.
+		FT_GlyphSlot		slot	= piFace->glyph;
+		GlyphCache::Glyph	glyph;
+
+		m_iPlaced.resize( slot->bitmap.width * slot->bitmap.rows );
+		GlyphCache::CopyBitmap( slot->bitmap, m_iPlaced.data() );
+
+		glyph.isValid	= true;
+		glyph.left		= slot->bitmap_left;
+		glyph.top		= slot->bitmap_top;
+		glyph.width		= slot->bitmap.width;
+		glyph.rows		= slot->bitmap.rows;
+		glyph.advance	= slot->advance;
+		glyph.bitmap	= m_iPlaced.data();
+
+		return	DrawPlaced( glyph, pen, draw );
+	}
+
+	// glyph moved by the integer part of pen -> draw(). false if it failed to load.
+	template<class Draw>
+	static	bool	DrawPlaced( const GlyphCache::Glyph& glyph, const FT_Vector& pen, Draw& draw )
 	{
-		return	DrawTextBGRA( x, y, GetUnicode32fromUTF8(str), color, image, stride, cx, cy );
+		GlyphCache::Glyph	placed	= glyph;
+
+		if( !placed.isValid )
+		{
+			return	false;
+		}
+
+		// FreeType leaves an empty bitmap (space) at 0,0 regardless of the pen.
+		if( (0 < placed.width) && (0 < placed.rows) )
+		{
+			placed.left	+= pen.x >> 6;
+			placed.top	+= pen.y >> 6;
+		}
+
+		draw( placed );
+
+		return	true;
 	}
-	
-	int DrawTextBGRA( int x, int y, const std::u32string& u32str, uint32_t color, uint8_t * image, int stride, int cx, int cy )
+
+	// DrawGlyph() copied out of the cache into m_tPlaced; the bitmap only if
+	// isBitmap (Layout() needs the metrics only). NULL if it can not be loaded.
+	const GlyphCache::Glyph*	LoadGlyph( uint32_t code, const FT_Vector& pen, bool isBitmap = true )
 	{
-		FT_Error		error;
-		FT_GlyphSlot	slot	= m_piFace->glyph;
-		FT_Matrix		matrix	= { 1 << 16, 0, 0, 1 << 16 };
-		FT_Vector		pen		= { 0, 0 };
-		uint32_t		alpha	= (color >> 24) + (color >> 31);
+		bool	isLoaded	= DrawGlyph( code, pen, [&]( const GlyphCache::Glyph& glyph )
+		{
+			CopyOut( glyph, isBitmap );
+		} );
 
-		for( size_t i = 0; i < u32str.size(); i++ )
+		return	isLoaded ? &m_tPlaced : NULL;
+	}
+
+	// glyph -> m_tPlaced, its bitmap -> m_iPlaced. Under the cache lock.
+	void	CopyOut( const GlyphCache::Glyph& glyph, bool isBitmap )
+	{
+		size_t	bytes	= (size_t)glyph.width * glyph.rows;
+
+		m_tPlaced			= glyph;
+		m_tPlaced.bitmap	= NULL;
+
+		if( isBitmap && (0 < bytes) )
 		{
-			switch( u32str[i] )
+			// not cacheable: already in m_iPlaced.
+			if( glyph.bitmap != m_iPlaced.data() )
 			{
-			case '\r':
-				break;
-				
-			case '\t':
-				pen.x	+= m_piFace->size->metrics.max_advance * 4;
-				pen.x	-= pen.x % (m_piFace->size->metrics.max_advance * 4);
-				break;
-
-			case '\n':
-				pen.x	= 0;
-				pen.y	-= m_piFace->size->metrics.height;
-				break;
-
-			default:
-				FT_Set_Transform( m_piFace, &matrix, &pen );
-	
-				error	= FT_Load_Char( m_piFace, u32str[i], FT_LOAD_RENDER );
-				if( 0 == error )
+				if( m_iPlaced.size() < bytes )
 				{
-					int	bmp_cy	= slot->bitmap.rows;
-					int	pos_y	= y + m_nBaseline - slot->bitmap_top;
-					int	rs		= 0 <= pos_y ? 0 : -pos_y;
-					int	re		= (pos_y + bmp_cy) <= cy ? bmp_cy : (cy - pos_y);
-	
-					int	bmp_cx	= slot->bitmap.width;
-					int	pos_x	= x + slot->bitmap_left;
-					int	cs		= 0 <= pos_x ? 0 : -pos_x;
-					int	ce		= (pos_x + bmp_cx) <= cx ? bmp_cx : (cx - pos_x);
-	
-					for( int r = rs; r < re; r++ )
-					{
-						uint8_t *	src_line	= &slot->bitmap.buffer[ bmp_cx * r ];
-						uint8_t *	dst_line	= &image[ stride * (pos_y + r) + (pos_x * 4) ];
-						int 		c			= cs;
-	
-						for( ; c < ce; c++ )
-						{
-							int32_t	a	= src_line[c+0];
-							
-							if( 0 < a )
-							{
-								uint8_t*	clr	= (uint8_t*)&color;
-								int32_t		d0	= dst_line[c*4+0];
-								int32_t		d1	= dst_line[c*4+1];
-								int32_t		d2	= dst_line[c*4+2];
-								int32_t		d3	= dst_line[c*4+3];
-		
-								a	+= a >> 7;
-								a	*= alpha;
-		
-								dst_line[c*4+0] = (uint8_t)( ((d0 << 16) + (clr[0] - d0) * a) >> 16 );
-								dst_line[c*4+1] = (uint8_t)( ((d1 << 16) + (clr[1] - d1) * a) >> 16 );
-								dst_line[c*4+2] = (uint8_t)( ((d2 << 16) + (clr[2] - d2) * a) >> 16 );
-								dst_line[c*4+3] = (uint8_t)( ((d3 << 16) + (clr[3] - d3) * a) >> 16 );
-							}
-						}
-					}
-	
-					pen.x	+= slot->advance.x;
-					pen.y	+= slot->advance.y;
+					m_iPlaced.resize( bytes );
 				}
-				break;
+
+				memcpy( m_iPlaced.data(), glyph.bitmap, bytes );
 			}
+
+			m_tPlaced.bitmap	= m_iPlaced.data();
 		}
-		
-		return	0;
 	}
 
 protected:
-	FT_Library		m_piLibrary;
-	FT_Face			m_piFace;
+	FT_Face			m_piFace;		// shared, FontRegistry
+	std::mutex*		m_pFaceLock;	// FontRegistry::GetFaceMutex()
+	FT_Size			m_piSize;
 	int				m_nBaseline;
+
+	bool			m_isMono;
+	uint64_t		m_nFileHash;	// FontRegistry::GetFileHash()
+	const CodepointSet*		m_pCoverage;	// FontRegistry::GetCoverage()
+	std::vector<Face>		m_iFallbacks;	// AddFallback()
+
+	GlyphCache*				m_pCache;
+	GlyphDiskCache*			m_pDiskCache;
+	TextRun					m_tRun;			// scratch of the overloads without a TextRun, one caller at a time
+	GlyphCache::Glyph		m_tPlaced;		// last LoadGlyph() result, copied out of the cache
+	std::vector<uint8_t>	m_iPlaced;		// its bitmap
 };
 
 #endif	// __IMG_FONT_H_INCLUDED__
\ No newline at end of file
@@ -0,0 +1,458 @@
+#ifndef	__IMG_FONT_REGISTRY_H_INCLUDED__
+#define	__IMG_FONT_REGISTRY_H_INCLUDED__
+
+//	Process-wide FreeType library and face registry.
+//
+//	Each font file is memory-mapped and opened once with FT_New_Memory_Face(),
+//	then shared by every ImageFont that names it. The pages of the file are
+//	read on demand and shared with the page cache, so a multi-megabyte CJK
+//	font costs its touched pages once, not a heap copy per ImageFont.
+//
+//	Faces are reference counted; the last Release() closes the face and
+//	unmaps the file. Sizes are per ImageFont (FT_New_Size), so a shared face
+//	can serve any number of heights. Fallback faces are only sized by ppem,
+//	their sizes are shared per face and ppem with AcquireSize().
+//
+//	A face and its sizes must be used by one thread at a time. ImageFont
+//	holds GetFaceMutex() while it calls FreeType, so fonts of the same file
+//	can render on different threads.
+//
+//	GetCoverage() is the set of codepoints in the cmap of a face, built once
+//	at Acquire(), so ImageFont picks a fallback face by a bit test instead of
+//	trying FT_Load_Char() on each face.
+//
+//	GetFileHash() identifies the contents of a font file across runs, for
+//	caches kept on disk (GlyphDiskCache). It hashes the size, the mtime and
+//	the first and last 64KB, so a large font is not read in full at startup.
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include FT_SIZES_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//	Set of Unicode codepoints, 2 levels: 256 codepoint pages, only pages
+//	with a member are stored.
+class CodepointSet
+{
+public:
+	enum
+	{
+		PAGE_SHIFT	= 8,
+		PAGE_WORDS	= (1 << PAGE_SHIFT) / 64,
+	};
+
+public:
+	void	Add( uint32_t code )
+	{
+		uint32_t	page	= code >> PAGE_SHIFT;
+
+		if( m_nPages.size() <= page )
+		{
+			m_nPages.resize( page + 1, 0 );
+		}
+
+		if( 0 == m_nPages[ page ] )
+		{
+			m_iBits.resize( m_iBits.size() + PAGE_WORDS, 0 );
+			m_nPages[ page ]	= (uint32_t)(m_iBits.size() / PAGE_WORDS);
+		}
+
+		m_iBits[ (m_nPages[ page ] - 1) * PAGE_WORDS + ((code >> 6) & (PAGE_WORDS - 1)) ]	|= (uint64_t)1 << (code & 63);
+	}
+
+	bool	Has( uint32_t code ) const
+	{
+		uint32_t	page	= code >> PAGE_SHIFT;
+
+		if( (m_nPages.size() <= page) || (0 == m_nPages[ page ]) )
+		{
+			return	false;
+		}
+
+		return	0 != ((m_iBits[ (m_nPages[ page ] - 1) * PAGE_WORDS + ((code >> 6) & (PAGE_WORDS - 1)) ] >> (code & 63)) & 1);
+	}
+
+	size_t	GetBytes() const
+	{
+		return	m_nPages.size() * sizeof(uint32_t) + m_iBits.size() * sizeof(uint64_t);
+	}
+
+protected:
+	std::vector<uint32_t>	m_nPages;	// 1 + page index in m_iBits, 0 = empty
+	std::vector<uint64_t>	m_iBits;
+};
+
+
+class FontRegistry
+{
+public:
+	static	FontRegistry&	GetInstance()
+	{
+		static	FontRegistry	iRegistry;
+
+		return	iRegistry;
+	}
+
+	FT_Library	GetLibrary() const
+	{
+		return	m_piLibrary;
+	}
+
+	// Face of filename (face index 0), loaded on first use.
+	FT_Face		Acquire( const char* filename )
+	{
+		std::lock_guard<std::mutex>	lock( m_iMutex );
+
+		auto	it	= m_iFaces.find( filename );
+
+		if( m_iFaces.end() != it )
+		{
+			it->second.nRefs++;
+			return	it->second.piFace;
+		}
+
+		FontFile	tFile	= { NULL, 0, NULL, 1, 0, std::make_shared<std::mutex>(), std::make_shared<CodepointSet>(), std::map<uint32_t,SizeRef>() };
+		struct stat	tStat;
+		int			fd;
+
+		fd	= ::open( filename, O_RDONLY );
+		if( fd < 0 )
+		{
+			printf( "ERROR: FontRegistry::Acquire() open( %s ) failed.\n", filename );
+			throw	"ERROR: FontRegistry::Acquire(), open() failed.";
+		}
+
+		if( (0 != fstat( fd, &tStat )) || (0 == tStat.st_size) )
+		{
+			::close( fd );
+			printf( "ERROR: FontRegistry::Acquire() fstat( %s ) failed.\n", filename );
+			throw	"ERROR: FontRegistry::Acquire(), fstat() failed.";
+		}
+
+		tFile.nSize	= tStat.st_size;
+		tFile.pData	= mmap( NULL, tFile.nSize, PROT_READ, MAP_SHARED, fd, 0 );
+		::close( fd );
+
+		if( MAP_FAILED == tFile.pData )
+		{
+			printf( "ERROR: FontRegistry::Acquire() mmap( %s ) failed.\n", filename );
+			throw	"ERROR: FontRegistry::Acquire(), mmap() failed.";
+		}
+
+		if( 0 != FT_New_Memory_Face( m_piLibrary, (const FT_Byte*)tFile.pData, tFile.nSize, 0, &tFile.piFace ) )
+		{
+			munmap( tFile.pData, tFile.nSize );
+			throw	"ERROR: FT_New_Memory_Face";
+		}
+
+		tFile.nHash	= HashFile( tFile, tStat );
+
+		{
+			FT_UInt		index;
+			FT_ULong	code	= FT_Get_First_Char( tFile.piFace, &index );
+
+			while( 0 != index )
+			{
+				tFile.pCoverage->Add( (uint32_t)code );
+				code	= FT_Get_Next_Char( tFile.piFace, code, &index );
+			}
+		}
+
+		m_iFaces[ filename ]	= tFile;
+
+		return	tFile.piFace;
+	}
+
+	// Returns true if this was the last reference and the face is gone.
+	bool		Release( FT_Face piFace )
+	{
+		std::lock_guard<std::mutex>	lock( m_iMutex );
+
+		for( auto it = m_iFaces.begin(); it != m_iFaces.end(); ++it )
+		{
+			if( piFace == it->second.piFace )
+			{
+				if( 0 < --it->second.nRefs )
+				{
+					return	false;
+				}
+
+				Close( it->second );
+				m_iFaces.erase( it );
+
+				return	true;
+			}
+		}
+
+		return	false;
+	}
+
+	// Size of piFace at the nominal ppem, shared by everyone asking for the
+	// same ppem. Use it under GetFaceMutex(). NULL if it can not be sized.
+	FT_Size		AcquireSize( FT_Face piFace, FT_UShort x_ppem, FT_UShort y_ppem )
+	{
+		std::lock_guard<std::mutex>	lock( m_iMutex );
+
+		for( auto& face : m_iFaces )
+		{
+			if( piFace != face.second.piFace )
+			{
+				continue;
+			}
+
+			uint32_t	key	= ((uint32_t)x_ppem << 16) | y_ppem;
+			auto		it	= face.second.iSizes.find( key );
+
+			if( face.second.iSizes.end() != it )
+			{
+				it->second.nRefs++;
+				return	it->second.piSize;
+			}
+
+			std::lock_guard<std::mutex>	faceLock( *face.second.pMutex );
+			FT_Size_RequestRec			tReqSize;
+			FT_Size						piSize;
+
+			tReqSize.type			= FT_SIZE_REQUEST_TYPE_NOMINAL;
+			tReqSize.width			= x_ppem << 6;
+			tReqSize.height			= y_ppem << 6;
+			tReqSize.horiResolution	= 0;
+			tReqSize.vertResolution	= 0;
+
+			if( 0 != FT_New_Size( piFace, &piSize ) )
+			{
+				return	NULL;
+			}
+
+			FT_Activate_Size( piSize );
+
+			if( 0 != FT_Request_Size( piFace, &tReqSize ) )
+			{
+				FT_Done_Size( piSize );
+				return	NULL;
+			}
+
+			face.second.iSizes[ key ]	= { piSize, 1 };
+			return	piSize;
+		}
+
+		return	NULL;
+	}
+
+	// The last release of a size from AcquireSize() frees it.
+	void		ReleaseSize( FT_Face piFace, FT_Size piSize )
+	{
+		std::lock_guard<std::mutex>	lock( m_iMutex );
+
+		for( auto& face : m_iFaces )
+		{
+			if( piFace != face.second.piFace )
+			{
+				continue;
+			}
+
+			for( auto it = face.second.iSizes.begin(); it != face.second.iSizes.end(); ++it )
+			{
+				if( (piSize == it->second.piSize) && (0 == --it->second.nRefs) )
+				{
+					std::lock_guard<std::mutex>	faceLock( *face.second.pMutex );
+
+					FT_Done_Size( piSize );
+					face.second.iSizes.erase( it );
+					break;
+				}
+			}
+			break;
+		}
+	}
+
+	// Contents hash of the file of piFace, 0 if not from this registry.
+	uint64_t	GetFileHash( FT_Face piFace )
+	{
+		std::lock_guard<std::mutex>	lock( m_iMutex );
+
+		for( auto& face : m_iFaces )
+		{
+			if( piFace == face.second.piFace )
+			{
+				return	face.second.nHash;
+			}
+		}
+
+		return	0;
+	}
+
+	// GetFileHash() of a file without acquiring it, 0 if it can not be read.
+	static	uint64_t	GetFileHash( const char* filename )
+	{
+		FontFile	tFile;
+		struct stat	tStat;
+		uint64_t	nHash;
+		int			fd;
+
+		fd	= ::open( filename, O_RDONLY );
+		if( fd < 0 )
+		{
+			return	0;
+		}
+
+		if( (0 != fstat( fd, &tStat )) || (0 == tStat.st_size) )
+		{
+			::close( fd );
+			return	0;
+		}
+
+		tFile.nSize	= tStat.st_size;
+		tFile.pData	= mmap( NULL, tFile.nSize, PROT_READ, MAP_SHARED, fd, 0 );
+		::close( fd );
+
+		if( MAP_FAILED == tFile.pData )
+		{
+			return	0;
+		}
+
+		nHash	= HashFile( tFile, tStat );
+		munmap( tFile.pData, tFile.nSize );
+
+		return	nHash;
+	}
+
+	// Lock of piFace and its sizes, valid while the face is acquired.
+	std::mutex*	GetFaceMutex( FT_Face piFace )
+	{
+		std::lock_guard<std::mutex>	lock( m_iMutex );
+
+		for( auto& face : m_iFaces )
+		{
+			if( piFace == face.second.piFace )
+			{
+				return	face.second.pMutex.get();
+			}
+		}
+
+		return	NULL;
+	}
+
+	// Codepoints of piFace, valid while the face is acquired.
+	const CodepointSet*	GetCoverage( FT_Face piFace )
+	{
+		std::lock_guard<std::mutex>	lock( m_iMutex );
+
+		for( auto& face : m_iFaces )
+		{
+			if( piFace == face.second.piFace )
+			{
+				return	face.second.pCoverage.get();
+			}
+		}
+
+		return	NULL;
+	}
+
+	// FNV-1a, 64bit. Chain calls by passing the previous result as h.
+	static	uint64_t	Hash( const void* data, size_t size, uint64_t h = 0xCBF29CE484222325ULL )
+	{
+		const uint8_t*	p	= (const uint8_t*)data;
+
+		for( size_t i = 0; i < size; i++ )
+		{
+			h	= (h ^ p[i]) * 0x100000001B3ULL;
+		}
+
+		return	h;
+	}
+
+	// Number of font files currently open.
+	size_t		GetFaceCount()
+	{
+		std::lock_guard<std::mutex>	lock( m_iMutex );
+
+		return	m_iFaces.size();
+	}
+
+protected:
+	struct SizeRef
+	{
+		FT_Size		piSize;
+		int			nRefs;
+	};
+
+	struct FontFile
+	{
+		void*		pData;
+		size_t		nSize;
+		FT_Face		piFace;
+		int			nRefs;
+		uint64_t	nHash;		// GetFileHash()
+
+		std::shared_ptr<std::mutex>	pMutex;		// GetFaceMutex()
+		std::shared_ptr<CodepointSet>	pCoverage;	// GetCoverage()
+		std::map<uint32_t,SizeRef>		iSizes;		// AcquireSize(), by x_ppem << 16 | y_ppem
+	};
+
+protected:
+	FontRegistry()
+	{
+		m_piLibrary	= NULL;
+
+		if( 0 != FT_Init_FreeType( &m_piLibrary ) )
+		{
+			throw	"ERROR: FT_Init_FreeType()";
+		}
+	}
+
+	~FontRegistry()
+	{
+		for( auto& face : m_iFaces )
+		{
+			Close( face.second );
+		}
+
+		FT_Done_FreeType( m_piLibrary );
+	}
+
+	static	uint64_t	HashFile( const FontFile& tFile, const struct stat& tStat )
+	{
+		const size_t	SAMPLE	= 64 * 1024;
+		const uint8_t*	data	= (const uint8_t*)tFile.pData;
+		uint64_t		size	= tFile.nSize;
+		int64_t			mtime	= tStat.st_mtime;
+		uint64_t		h;
+
+		h	= Hash( &size, sizeof(size) );
+		h	= Hash( &mtime, sizeof(mtime), h );
+
+		if( tFile.nSize <= (SAMPLE * 2) )
+		{
+			return	Hash( data, tFile.nSize, h );
+		}
+
+		h	= Hash( data, SAMPLE, h );
+		return	Hash( data + tFile.nSize - SAMPLE, SAMPLE, h );
+	}
+
+	static	void	Close( FontFile& tFile )
+	{
+		// the face must go before the memory it reads from.
+		FT_Done_Face( tFile.piFace );
+		munmap( tFile.pData, tFile.nSize );
+	}
+
+protected:
+	FT_Library						m_piLibrary;
+	std::map<std::string,FontFile>	m_iFaces;
+	std::mutex						m_iMutex;
+};
+
+#endif	// __IMG_FONT_REGISTRY_H_INCLUDED__
@@ -0,0 +1,307 @@
+#ifndef	__IMG_GLYPH_ATLAS_H_INCLUDED__
+#define	__IMG_GLYPH_ATLAS_H_INCLUDED__
+
+//	Pre-rendered glyph strip for areas with a small fixed alphabet.
+//	(clock, date, temperature, volume)
+//
+//	Every character of the alphabet is rendered once into a cell of the
+//	area height, already placed at the text row. A string is then composed
+//	from the cells with the same blending as ImageFont::DrawTextGRAY() /
+//	DrawTextBGRA() / DrawTextRGB565(), so the result is identical, without layout or cache
+//	lookups per frame.
+//
+//	CalcDirty() compares two strings cell by cell and returns the columns
+//	that changed, so an area only needs to recompose and send that span.
+//
+//	Characters outside the alphabet are rendered on first use.
+//	Advances are taken as whole pixels. (hinted fonts)
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+#include "img_font.h"
+
+class GlyphAtlas
+{
+public:
+	GlyphAtlas()
+	{
+		m_pFont		= NULL;
+		m_nY		= 0;
+		m_nHeight	= 0;
+	}
+
+	// y: text position in the area as DrawTextGRAY( x, y, ... ), cy: area height.
+	void	Create( ImageFont& iFont, const char* alphabet, int y, int cy )
+	{
+		m_pFont		= &iFont;
+		m_nY		= y;
+		m_nHeight	= cy;
+
+		m_iCells.clear();
+		m_iIndex.clear();
+		m_iStrip.clear();
+		memset( m_nAscii, -1, sizeof(m_nAscii) );
+
+		Utf8Iterator	it( alphabet );
+		uint32_t		code;
+
+		while( it.Next( code ) )
+		{
+			GetCell( code );
+		}
+	}
+
+	// Ink span of str drawn at x = 0, as TextRun::left / right.
+	void	CalcSpan( const char* str, int& left, int& right )
+	{
+		Utf8Iterator	it( str );
+		uint32_t		code;
+		int				pen		= 0;
+		bool			isFirst	= true;
+
+		left	= 0;
+		right	= 0;
+
+		while( it.Next( code ) )
+		{
+			const Cell&	cell	= m_iCells[ GetCell( code ) ];
+
+			if( cell.isValid )
+			{
+				// an empty glyph (space) counts at the origin, as ImageFont::Layout().
+				int	l	= (0 < cell.width ? pen : 0) + cell.left;
+				int	r	= l + cell.width;
+
+				left	= (isFirst || (l < left)) ? l : left;
+				right	= (isFirst || (right < r)) ? r : right;
+				isFirst	= false;
+			}
+
+			pen	+= cell.advance;
+		}
+	}
+
+	// Columns [left,right) that differ between prev drawn at prev_x and cur drawn at cur_x.
+	// false if nothing changed.
+	bool	CalcDirty( int prev_x, const char* prev, int cur_x, const char* cur, int& left, int& right )
+	{
+		Utf8Iterator	it0( prev );
+		Utf8Iterator	it1( cur );
+		uint32_t		code0;
+		uint32_t		code1;
+		int				pen0	= prev_x;
+		int				pen1	= cur_x;
+
+		left	= 0;
+		right	= 0;
+
+		for( ;; )
+		{
+			bool		is0		= it0.Next( code0 );
+			bool		is1		= it1.Next( code1 );
+
+			if( !is0 && !is1 )
+			{
+				break;
+			}
+
+			int			n0		= is0 ? GetCell( code0 ) : -1;
+			int			n1		= is1 ? GetCell( code1 ) : -1;
+			const Cell*	cell0	= 0 <= n0 ? &m_iCells[ n0 ] : NULL;
+			const Cell*	cell1	= 0 <= n1 ? &m_iCells[ n1 ] : NULL;
+
+			if( (n0 != n1) || (pen0 != pen1) )
+			{
+				AddSpan( cell0, pen0, left, right );
+				AddSpan( cell1, pen1, left, right );
+			}
+
+			pen0	+= NULL != cell0 ? cell0->advance : 0;
+			pen1	+= NULL != cell1 ? cell1->advance : 0;
+		}
+
+		return	left < right;
+	}
+
+	// image: cx x area height, 8bit.
+	void	ComposeGRAY( int x, const char* str, uint8_t color, uint8_t* image, int stride, int cx )
+	{
+		Utf8Iterator	it( str );
+		uint32_t		code;
+
+		while( it.Next( code ) )
+		{
+			const Cell&	cell	= m_iCells[ GetCell( code ) ];
+			int			pos_x	= x + cell.left;
+			int			cs		= 0 <= pos_x ? 0 : -pos_x;
+			int			ce		= (pos_x + cell.width) <= cx ? cell.width : (cx - pos_x);
+
+			if( cs < ce )
+			{
+				ImageBlend::A8overGRAY8( &m_iStrip[ cell.offset + cs ], cell.width, ce - cs, m_nHeight, color, &image[ pos_x + cs ], stride );
+			}
+
+			x	+= cell.advance;
+		}
+	}
+
+	// image: cx x area height, BGRA.
+	void	ComposeBGRA( int x, const char* str, uint32_t color, uint8_t* image, int stride, int cx )
+	{
+		Utf8Iterator	it( str );
+		uint32_t		code;
+
+		while( it.Next( code ) )
+		{
+			const Cell&	cell	= m_iCells[ GetCell( code ) ];
+			int			pos_x	= x + cell.left;
+			int			cs		= 0 <= pos_x ? 0 : -pos_x;
+			int			ce		= (pos_x + cell.width) <= cx ? cell.width : (cx - pos_x);
+
+			if( cs < ce )
+			{
+				ImageBlend::A8overBGRA8888( &m_iStrip[ cell.offset + cs ], cell.width, ce - cs, m_nHeight, color, &image[ (pos_x + cs) * 4 ], stride );
+			}
+
+			x	+= cell.advance;
+		}
+	}
+
+	// image: cx x area height, RGB565 (MSB first), color: ARGB.
+	void	ComposeRGB565( int x, const char* str, uint32_t color, uint8_t* image, int stride, int cx )
+	{
+		Utf8Iterator	it( str );
+		uint32_t		code;
+
+		while( it.Next( code ) )
+		{
+			const Cell&	cell	= m_iCells[ GetCell( code ) ];
+			int			pos_x	= x + cell.left;
+			int			cs		= 0 <= pos_x ? 0 : -pos_x;
+			int			ce		= (pos_x + cell.width) <= cx ? cell.width : (cx - pos_x);
+
+			if( cs < ce )
+			{
+				ImageBlend::A8overRGB565( &m_iStrip[ cell.offset + cs ], cell.width, ce - cs, m_nHeight, color, &image[ (pos_x + cs) * 2 ], stride );
+			}
+
+			x	+= cell.advance;
+		}
+	}
+
+	int		GetHeight() const
+	{
+		return	m_nHeight;
+	}
+
+	// Bytes of pre-rendered cells.
+	size_t	GetBytes() const
+	{
+		return	m_iStrip.size();
+	}
+
+protected:
+	struct Cell
+	{
+		bool		isValid;	// false: not in the font, drawn as nothing
+		int			left;		// bitmap_left, x of the cell from the pen
+		int			width;
+		int			advance;	// pixels
+		size_t		offset;		// in m_iStrip, width x m_nHeight
+	};
+
+protected:
+	int		GetCell( uint32_t code )
+	{
+		if( code < 128 )
+		{
+			if( 0 <= m_nAscii[ code ] )
+			{
+				return	m_nAscii[ code ];
+			}
+
+			m_nAscii[ code ]	= AddCell( code );
+			return	m_nAscii[ code ];
+		}
+
+		auto	it	= m_iIndex.find( code );
+
+		if( m_iIndex.end() != it )
+		{
+			return	it->second;
+		}
+
+		int		n	= AddCell( code );
+
+		m_iIndex[ code ]	= n;
+		return	n;
+	}
+
+	// Render code at pen 0 into a new cell, clipped to the area rows like DrawTextGRAY().
+	int		AddCell( uint32_t code )
+	{
+		FT_Vector					pen		= { 0, 0 };
+		const GlyphCache::Glyph*	glyph	= m_pFont->GetGlyph( code, pen );
+		Cell						cell	= { false, 0, 0, 0, m_iStrip.size() };
+
+		if( NULL != glyph )
+		{
+			int	pos_y	= m_nY + m_pFont->GetBaseline() - glyph->top;
+			int	rs		= 0 <= pos_y ? 0 : -pos_y;
+			int	re		= (pos_y + glyph->rows) <= m_nHeight ? glyph->rows : (m_nHeight - pos_y);
+
+			cell.isValid	= true;
+			cell.left		= glyph->left;
+			cell.width		= 0 < glyph->rows ? glyph->width : 0;
+			cell.advance	= glyph->advance.x >> 6;
+
+			m_iStrip.resize( cell.offset + cell.width * m_nHeight, 0 );
+
+			for( int r = rs; r < re; r++ )
+			{
+				memcpy( &m_iStrip[ cell.offset + cell.width * (pos_y + r) ], &glyph->bitmap[ glyph->width * r ], cell.width );
+			}
+		}
+
+		m_iCells.push_back( cell );
+
+		return	(int)m_iCells.size() - 1;
+	}
+
+	static	void	AddSpan( const Cell* cell, int pen, int& left, int& right )
+	{
+		if( (NULL == cell) || (0 == cell->width) )
+		{
+			return;
+		}
+
+		int	l	= pen + cell->left;
+		int	r	= pen + cell->left + cell->width;
+
+		if( left < right )
+		{
+			left	= l < left ? l : left;
+			right	= right < r ? r : right;
+		}
+		else
+		{
+			left	= l;
+			right	= r;
+		}
+	}
+
+protected:
+	ImageFont*					m_pFont;
+	int							m_nY;
+	int							m_nHeight;
+
+	std::vector<Cell>			m_iCells;
+	std::vector<uint8_t>		m_iStrip;		// all cells, each width x m_nHeight
+	int							m_nAscii[ 128 ];	// index of m_iCells, -1 = not yet
+	std::map<uint32_t,int>		m_iIndex;		// other codes
+};
+
+#endif	// __IMG_GLYPH_ATLAS_H_INCLUDED__
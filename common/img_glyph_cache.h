@@ -0,0 +1,347 @@
+#ifndef	__IMG_GLYPH_CACHE_H_INCLUDED__
+#define	__IMG_GLYPH_CACHE_H_INCLUDED__
+
+//	Rendered glyph cache for ImageFont.
+//
+//	Key:	face, scale, codepoint, the 26.6 sub-pixel phase of the pen and
+//			the render mode. Fonts of the same face and height share entries,
+//			and the phase is 0 for hinted fonts, so one entry per codepoint.
+//	Value:	coverage bitmap (8bit, pitch = width) and metrics.
+//			Mono glyphs (FT_LOAD_TARGET_MONO) are stored as 0x00 / 0xFF.
+//
+//	Bitmaps live in an arena of power-of-2 size classes carved from 64KB
+//	blocks, so a miss after warm-up reuses an evicted slot instead of calling
+//	malloc. Entries are evicted in LRU order when the bitmaps exceed the
+//	capacity. Glyphs that failed to load are cached too.
+//
+//	Not thread safe by itself. A Glyph pointer is valid until the next Insert()
+//	or Purge(), so users on several threads hold GetMutex() from Find() until
+//	they have copied the glyph out. ImageFont does, so one cache serves fonts
+//	that render on worker threads.
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include <stdint.h>
+#include <string.h>
+#include <list>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+class GlyphCache
+{
+public:
+	struct Key
+	{
+		FT_Face		face;
+		FT_Fixed	x_scale;	// FT_Size_Metrics, i.e. the pixel size
+		FT_Fixed	y_scale;
+		uint32_t	code;
+		uint16_t	phase;		// (pen.y & 63) << 6 | (pen.x & 63)
+		uint16_t	mode;		// FT_Render_Mode
+
+		bool	operator == ( const Key& key ) const
+		{
+			return	(face == key.face) && (x_scale == key.x_scale) && (y_scale == key.y_scale) && (code == key.code) && (phase == key.phase) && (mode == key.mode);
+		}
+	};
+
+	struct Glyph
+	{
+		bool			isValid;		// false: FT_Load_Char() failed
+		int				left;			// bitmap_left
+		int				top;			// bitmap_top
+		int				width;
+		int				rows;
+		FT_Vector		advance;
+		const uint8_t*	bitmap;			// width x rows, pitch = width
+	};
+
+	enum
+	{
+		BLOCK_SIZE	= 64 * 1024,
+		MIN_SHIFT	= 4,				// smallest slot, 16 bytes
+		CLASSES		= 13,				// 16 .. 64KB
+	};
+
+public:
+	GlyphCache( size_t nCapacity = 1024 * 1024 )
+	{
+		m_nCapacity		= nCapacity;
+		m_nBytes		= 0;
+		m_nHits			= 0;
+		m_nMisses		= 0;
+		m_nEvictions	= 0;
+		m_pBlockPos		= NULL;
+		m_nBlockRemain	= 0;
+	}
+
+	// Shared by all ImageFont instances.
+	static	GlyphCache&		GetDefault()
+	{
+		static	GlyphCache	iCache;
+
+		return	iCache;
+	}
+
+	// Held around Find() / Insert() / Purge() and the use of their result
+	// when the cache is shared between threads.
+	std::mutex&		GetMutex()
+	{
+		return	m_iMutex;
+	}
+
+	// NULL on a miss. A hit becomes the most recently used entry.
+	const Glyph*	Find( const Key& key )
+	{
+		auto	it	= m_iIndex.find( key );
+
+		if( m_iIndex.end() == it )
+		{
+			m_nMisses++;
+			return	NULL;
+		}
+
+		m_nHits++;
+		m_iLRU.splice( m_iLRU.begin(), m_iLRU, it->second );
+
+		return	&it->second->glyph;
+	}
+
+	// Copy the rendered slot (or NULL when loading failed) into the cache.
+	const Glyph*	Insert( const Key& key, const FT_GlyphSlot slot )
+	{
+		Glyph		glyph;
+
+		memset( &glyph, 0, sizeof(glyph) );
+
+		if( NULL != slot )
+		{
+			glyph.isValid	= true;
+			glyph.left		= slot->bitmap_left;
+			glyph.top		= slot->bitmap_top;
+			glyph.width		= slot->bitmap.width;
+			glyph.rows		= slot->bitmap.rows;
+			glyph.advance	= slot->advance;
+		}
+
+		return	Store( key, glyph, NULL != slot ? &slot->bitmap : NULL );
+	}
+
+	// Copy an already rendered glyph into the cache. (GlyphDiskCache)
+	const Glyph*	Insert( const Key& key, const Glyph& glyph )
+	{
+		return	Store( key, glyph, NULL );
+	}
+
+	// Rendered bitmap -> 8bit coverage, pitch = width. (mono: 0x00 / 0xFF)
+	static	void	CopyBitmap( const FT_Bitmap& bitmap, uint8_t* dst )
+	{
+		int		width	= bitmap.width;
+
+		for( int r = 0; r < (int)bitmap.rows; r++ )
+		{
+			const uint8_t*	src	= &bitmap.buffer[ bitmap.pitch * r ];
+
+			if( FT_PIXEL_MODE_MONO == bitmap.pixel_mode )
+			{
+				// MSB = left
+				for( int c = 0; c < width; c++ )
+				{
+					dst[ width * r + c ]	= 0 - ((src[ c / 8 ] >> (7 - (c & 7))) & 1);
+				}
+			}
+			else
+			{
+				memcpy( &dst[ width * r ], src, width );
+			}
+		}
+	}
+
+	// Drop every entry of face. (called when the face is released)
+	void	Purge( FT_Face face )
+	{
+		for( auto it = m_iLRU.begin(); it != m_iLRU.end(); )
+		{
+			auto	cur	= it++;
+
+			if( face == cur->key.face )
+			{
+				Remove( cur );
+			}
+		}
+	}
+
+	size_t		GetBytes() const		{ return	m_nBytes;		}
+	size_t		GetCount() const		{ return	m_iIndex.size();	}
+	uint64_t	GetHits() const			{ return	m_nHits;		}
+	uint64_t	GetMisses() const		{ return	m_nMisses;		}
+	uint64_t	GetEvictions() const	{ return	m_nEvictions;	}
+
+	void	ResetCounters()
+	{
+		m_nHits			= 0;
+		m_nMisses		= 0;
+		m_nEvictions	= 0;
+	}
+
+protected:
+	struct Entry
+	{
+		Key			key;
+		Glyph		glyph;
+		int			nClass;		// arena size class, -1 = no bitmap
+	};
+
+	struct KeyHash
+	{
+		size_t	operator () ( const Key& key ) const
+		{
+			uint64_t	h	= (uint64_t)(uintptr_t)key.face;
+
+			h	= h * 0x9E3779B97F4A7C15ULL ^ (uint64_t)key.x_scale;
+			h	= h * 0x9E3779B97F4A7C15ULL ^ (uint64_t)key.y_scale;
+			h	= h * 0x9E3779B97F4A7C15ULL ^ key.code;
+			h	= h * 0x9E3779B97F4A7C15ULL ^ ((uint32_t)key.mode << 16 | key.phase);
+
+			return	(size_t)(h ^ (h >> 29));
+		}
+	};
+
+	typedef	std::list<Entry>::iterator	EntryIt;
+
+protected:
+	// bitmap: FreeType source, NULL to copy glyph.bitmap.
+	const Glyph*	Store( const Key& key, const Glyph& glyph, const FT_Bitmap* bitmap )
+	{
+		Entry		entry;
+		int			bytes	= glyph.width * glyph.rows;
+
+		entry.key			= key;
+		entry.glyph			= glyph;
+		entry.glyph.bitmap	= NULL;
+		entry.nClass		= -1;
+
+		if( glyph.isValid && (0 < bytes) )
+		{
+			entry.nClass	= GetClass( bytes );
+
+			if( entry.nClass < 0 )
+			{
+				// larger than a block, not cacheable.
+				return	NULL;
+			}
+
+			Evict( (size_t)1 << (entry.nClass + MIN_SHIFT) );
+
+			uint8_t*	dst	= Alloc( entry.nClass );
+
+			if( NULL != bitmap )
+			{
+				CopyBitmap( *bitmap, dst );
+			}
+			else
+			{
+				memcpy( dst, glyph.bitmap, bytes );
+			}
+
+			entry.glyph.bitmap	= dst;
+			m_nBytes			+= (size_t)1 << (entry.nClass + MIN_SHIFT);
+		}
+
+		auto	old	= m_iIndex.find( key );
+
+		if( m_iIndex.end() != old )
+		{
+			Remove( old->second );
+		}
+
+		m_iLRU.push_front( entry );
+		m_iIndex[ key ]	= m_iLRU.begin();
+
+		return	&m_iLRU.front().glyph;
+	}
+
+	static	int		GetClass( int bytes )
+	{
+		for( int c = 0; c < CLASSES; c++ )
+		{
+			if( bytes <= (1 << (c + MIN_SHIFT)) )
+			{
+				return	c;
+			}
+		}
+
+		return	-1;
+	}
+
+	uint8_t*	Alloc( int nClass )
+	{
+		std::vector<uint8_t*>&	iFree	= m_iFree[ nClass ];
+		size_t					size	= (size_t)1 << (nClass + MIN_SHIFT);
+
+		if( !iFree.empty() )
+		{
+			uint8_t*	p	= iFree.back();
+
+			iFree.pop_back();
+			return	p;
+		}
+
+		if( m_nBlockRemain < size )
+		{
+			m_iBlocks.push_back( std::unique_ptr<uint8_t[]>( new uint8_t[ BLOCK_SIZE ] ) );
+			m_pBlockPos		= m_iBlocks.back().get();
+			m_nBlockRemain	= BLOCK_SIZE;
+		}
+
+		uint8_t*	p	= m_pBlockPos;
+
+		m_pBlockPos		+= size;
+		m_nBlockRemain	-= size;
+
+		return	p;
+	}
+
+	// Evict the least recently used entries until bytes more fit.
+	void	Evict( size_t bytes )
+	{
+		while( !m_iLRU.empty() && (m_nCapacity < (m_nBytes + bytes)) )
+		{
+			Remove( std::prev( m_iLRU.end() ) );
+			m_nEvictions++;
+		}
+	}
+
+	void	Remove( EntryIt it )
+	{
+		if( 0 <= it->nClass )
+		{
+			m_iFree[ it->nClass ].push_back( (uint8_t*)it->glyph.bitmap );
+			m_nBytes	-= (size_t)1 << (it->nClass + MIN_SHIFT);
+		}
+
+		m_iIndex.erase( it->key );
+		m_iLRU.erase( it );
+	}
+
+protected:
+	size_t										m_nCapacity;
+	size_t										m_nBytes;		// bitmap slots in use
+	uint64_t									m_nHits;
+	uint64_t									m_nMisses;
+	uint64_t									m_nEvictions;
+
+	std::mutex									m_iMutex;		// GetMutex()
+	std::list<Entry>							m_iLRU;			// front = most recently used
+	std::unordered_map<Key,EntryIt,KeyHash>		m_iIndex;
+
+	std::vector<std::unique_ptr<uint8_t[]>>		m_iBlocks;
+	std::vector<uint8_t*>						m_iFree[ CLASSES ];
+	uint8_t*									m_pBlockPos;
+	size_t										m_nBlockRemain;
+};
+
+#endif	// __IMG_GLYPH_CACHE_H_INCLUDED__
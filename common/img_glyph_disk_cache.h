@@ -0,0 +1,526 @@
+#ifndef	__IMG_GLYPH_DISK_CACHE_H_INCLUDED__
+#define	__IMG_GLYPH_DISK_CACHE_H_INCLUDED__
+
+//	Rendered glyphs kept in a file across runs, behind GlyphCache.
+//
+//	Open() memory-maps the file and indexes its records. A GlyphCache miss
+//	is looked up here before FreeType renders the glyph, and newly rendered
+//	glyphs are appended, so the UI glyphs of a boot are rasterised once.
+//
+//	Key:	FontRegistry::GetFileHash() of the font file instead of the face,
+//			then the same scale, codepoint, phase and render mode as
+//			GlyphCache::Key. A changed font file hashes differently, so its
+//			old records are never hit again.
+//	File:	Header with the FreeType version, then records of Record +
+//			width x rows bitmap, padded to 8 bytes. Each record carries a
+//			FNV-1a check; a torn or corrupt tail ends the scan.
+//
+//	Rebuild:	The file is never truncated, other instances may have it
+//			mapped and would get SIGBUS. Instead the records to keep are
+//			written to a new file that is rename()d over the old one. Open()
+//			rebuilds on another version or FreeType, a torn tail, a nearly
+//			full file, or when most records belong to none of the fonts
+//			given. A full file during the run is rebuilt once with the fonts
+//			used so far.
+//
+//	Records appended in this run are not indexed, GlyphCache holds them.
+//	Only the process holding the file lock appends. Find() and Append() may
+//	be called from several threads; Open() and Close() may not.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <mutex>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "img_glyph_cache.h"
+#include "img_font_registry.h"
+
+class GlyphDiskCache
+{
+public:
+	struct Key
+	{
+		uint64_t	font;		// FontRegistry::GetFileHash()
+		int64_t		x_scale;
+		int64_t		y_scale;
+		uint32_t	code;
+		uint16_t	phase;
+		uint16_t	mode;
+
+		bool	operator == ( const Key& key ) const
+		{
+			return	(font == key.font) && (x_scale == key.x_scale) && (y_scale == key.y_scale) && (code == key.code) && (phase == key.phase) && (mode == key.mode);
+		}
+	};
+
+	enum
+	{
+		MAGIC			= 0x43474649,		// "IFGC"
+		VERSION			= 2,
+		MAX_FILE_SIZE	= 8 * 1024 * 1024,
+		FULL_SIZE		= MAX_FILE_SIZE / 8 * 7,	// Open() rebuilds above this
+		KEEP_SIZE		= MAX_FILE_SIZE / 4 * 3,	// a rebuild keeps up to this
+	};
+
+public:
+	GlyphDiskCache()
+	{
+		m_nFd			= -1;
+		m_pMap			= NULL;
+		m_nMapSize		= 0;
+		m_nFileSize		= 0;
+		m_isWritable	= false;
+		m_isRebuilt		= false;
+		m_nHits			= 0;
+		m_nMisses		= 0;
+	}
+
+	~GlyphDiskCache()
+	{
+		Close();
+	}
+
+	// Used by ImageFont once opened.
+	static	GlyphDiskCache&		GetDefault()
+	{
+		static	GlyphDiskCache	iCache;
+
+		return	iCache;
+	}
+
+	// Created if missing. fonts: the font files in use, records of other
+	// files are stale. false: no cache, ImageFont renders as before.
+	bool	Open( const char* filename, const std::vector<const char*>& fonts = std::vector<const char*>() )
+	{
+		struct stat	tStat;
+		Header		tHeader;
+		bool		isCurrent;
+
+		Close();
+
+		m_strFilename	= filename;
+
+		m_nFd	= ::open( filename, O_RDWR | O_CREAT, 0644 );
+		if( m_nFd < 0 )
+		{
+			printf( "WARNING: GlyphDiskCache::Open() open( %s ) failed.\n", filename );
+			return	false;
+		}
+
+		// another instance appends, read only.
+		m_isWritable	= 0 == flock( m_nFd, LOCK_EX | LOCK_NB );
+
+		if( 0 != fstat( m_nFd, &tStat ) )
+		{
+			Close();
+			return	false;
+		}
+
+		isCurrent	= (sizeof(tHeader) <= (size_t)tStat.st_size) && ((size_t)tStat.st_size <= MAX_FILE_SIZE) &&
+					  (sizeof(tHeader) == pread( m_nFd, &tHeader, sizeof(tHeader), 0 )) && (0 == memcmp( &tHeader, &GetHeader(), sizeof(tHeader) ));
+
+		if( isCurrent && !Map( tStat.st_size ) )
+		{
+			Close();
+			return	false;
+		}
+
+		for( auto pszFont : fonts )
+		{
+			uint64_t	nHash	= FontRegistry::GetFileHash( pszFont );
+
+			if( 0 != nHash )
+			{
+				m_iFonts.insert( nHash );
+			}
+		}
+
+		if( m_isWritable )
+		{
+			size_t	nLive	= 0;
+			size_t	nAll	= 0;
+
+			for( auto& it : m_iIndex )
+			{
+				const Record*	rec		= (const Record*)&m_pMap[ it.second ];
+				size_t			size	= GetSize( *rec );
+
+				nAll	+= size;
+				nLive	+= IsUsed( *rec ) ? size : 0;
+			}
+
+			bool	isTorn	= m_nFileSize < (size_t)tStat.st_size;
+			bool	isFull	= FULL_SIZE < m_nFileSize;
+			bool	isStale	= nAll < (nAll - nLive) * 2;
+
+			if( !isCurrent || isTorn || isFull || isStale )
+			{
+				// torn only: keep every valid record.
+				bool	isAll	= !isFull && !isStale;
+
+				if( !Rebuild( isAll ? MAX_FILE_SIZE : KEEP_SIZE, [&]( const Record& rec ){ return	isAll || IsUsed( rec ); } ) || !Map( m_nFileSize ) )
+				{
+					m_isWritable	= false;
+				}
+			}
+		}
+
+		return	true;
+	}
+
+	void	Close()
+	{
+		if( NULL != m_pMap )
+		{
+			munmap( m_pMap, m_nMapSize );
+		}
+
+		if( 0 <= m_nFd )
+		{
+			::close( m_nFd );
+		}
+
+		m_nFd			= -1;
+		m_pMap			= NULL;
+		m_nMapSize		= 0;
+		m_nFileSize		= 0;
+		m_isWritable	= false;
+		m_isRebuilt		= false;
+
+		m_strFilename.clear();
+		m_iIndex.clear();
+		m_iAppended.clear();
+		m_iFonts.clear();
+	}
+
+	bool	IsOpen() const
+	{
+		return	0 <= m_nFd;
+	}
+
+	// glyph.bitmap points into the mapped file, valid until Close().
+	bool	Find( const Key& key, GlyphCache::Glyph& glyph )
+	{
+		std::lock_guard<std::mutex>	lock( m_iMutex );
+
+		m_iFonts.insert( key.font );
+
+		auto	it	= m_iIndex.find( key );
+
+		if( m_iIndex.end() == it )
+		{
+			m_nMisses++;
+			return	false;
+		}
+
+		const Record*	rec	= (const Record*)&m_pMap[ it->second ];
+
+		glyph.isValid	= 0 != rec->isValid;
+		glyph.left		= rec->left;
+		glyph.top		= rec->top;
+		glyph.width		= rec->width;
+		glyph.rows		= rec->rows;
+		glyph.advance.x	= rec->advance_x;
+		glyph.advance.y	= rec->advance_y;
+		glyph.bitmap	= (const uint8_t*)(rec + 1);
+
+		m_nHits++;
+		return	true;
+	}
+
+	// Add a rendered glyph (bitmap pitch = width). Known keys are ignored.
+	void	Append( const Key& key, const GlyphCache::Glyph& glyph )
+	{
+		std::lock_guard<std::mutex>	lock( m_iMutex );
+
+		if( !m_isWritable || (m_iIndex.end() != m_iIndex.find( key )) || (m_iAppended.end() != m_iAppended.find( key )) )
+		{
+			return;
+		}
+
+		size_t	bytes	= glyph.isValid ? (size_t)glyph.width * glyph.rows : 0;
+		size_t	size	= sizeof(Record) + Align( bytes );
+
+		m_iFonts.insert( key.font );
+
+		if( MAX_FILE_SIZE < (m_nFileSize + size) )
+		{
+			// once per run, Find() keeps using the old map.
+			bool	isRebuilt	= !m_isRebuilt && Rebuild( KEEP_SIZE, [&]( const Record& rec ){ return	IsUsed( rec ); } );
+
+			m_isRebuilt	= true;
+
+			if( !isRebuilt || (MAX_FILE_SIZE < (m_nFileSize + size)) )
+			{
+				return;
+			}
+		}
+
+		Record	rec;
+
+		memset( &rec, 0, sizeof(rec) );
+		rec.key			= key;
+		rec.isValid		= glyph.isValid ? 1 : 0;
+		rec.left		= glyph.left;
+		rec.top			= glyph.top;
+		rec.width		= bytes ? glyph.width : 0;
+		rec.rows		= bytes ? glyph.rows : 0;
+		rec.advance_x	= glyph.advance.x;
+		rec.advance_y	= glyph.advance.y;
+		rec.check		= Check( rec, glyph.bitmap, bytes );
+
+		m_iBuffer.assign( size, 0 );
+		memcpy( &m_iBuffer[ 0 ], &rec, sizeof(rec) );
+
+		if( 0 < bytes )
+		{
+			memcpy( &m_iBuffer[ sizeof(rec) ], glyph.bitmap, bytes );
+		}
+
+		if( (ssize_t)size != pwrite( m_nFd, m_iBuffer.data(), size, m_nFileSize ) )
+		{
+			// disk full or read only. a partial record is a torn tail for the next Open().
+			m_isWritable	= false;
+			return;
+		}
+
+		m_iAppended[ key ]	= m_nFileSize;
+		m_nFileSize			+= size;
+	}
+
+	size_t		GetCount() const		{ return	m_iIndex.size() + m_iAppended.size();	}
+	size_t		GetFileSize() const		{ return	m_nFileSize;	}
+	uint64_t	GetHits() const			{ return	m_nHits;		}
+	uint64_t	GetMisses() const		{ return	m_nMisses;		}
+
+protected:
+	struct Header
+	{
+		uint32_t	magic;
+		uint32_t	version;
+		uint32_t	freetype;		// major << 16 | minor << 8 | patch, renders differ
+		uint32_t	reserved;
+	};
+
+	struct Record
+	{
+		Key			key;
+		int32_t		advance_x;		// 26.6
+		int32_t		advance_y;
+		int16_t		left;
+		int16_t		top;
+		uint16_t	width;			// 0 if no bitmap
+		uint16_t	rows;
+		uint8_t		isValid;
+		uint8_t		reserved[ 3 ];
+		uint32_t	check;			// Check()
+	};
+
+	struct KeyHash
+	{
+		size_t	operator () ( const Key& key ) const
+		{
+			return	(size_t)FontRegistry::Hash( &key, sizeof(key) );
+		}
+	};
+
+protected:
+	static	size_t	Align( size_t bytes )
+	{
+		return	(bytes + 7) & ~(size_t)7;
+	}
+
+	static	size_t	GetSize( const Record& rec )
+	{
+		return	sizeof(Record) + Align( (size_t)rec.width * rec.rows );
+	}
+
+	static	const Header&	GetHeader()
+	{
+		static	Header	tHeader	= MakeHeader();
+
+		return	tHeader;
+	}
+
+	static	Header	MakeHeader()
+	{
+		Header	tHeader;
+		FT_Int	major	= 0;
+		FT_Int	minor	= 0;
+		FT_Int	patch	= 0;
+
+		FT_Library_Version( FontRegistry::GetInstance().GetLibrary(), &major, &minor, &patch );
+
+		tHeader.magic		= MAGIC;
+		tHeader.version		= VERSION;
+		tHeader.freetype	= (major << 16) | (minor << 8) | patch;
+		tHeader.reserved	= 0;
+
+		return	tHeader;
+	}
+
+	bool	IsUsed( const Record& rec ) const
+	{
+		return	m_iFonts.empty() || (m_iFonts.end() != m_iFonts.find( rec.key.font ));
+	}
+
+	// Map size bytes of m_nFd and index them.
+	bool	Map( size_t size )
+	{
+		if( NULL != m_pMap )
+		{
+			munmap( m_pMap, m_nMapSize );
+		}
+
+		m_iIndex.clear();
+		m_nMapSize	= size;
+		m_pMap		= (uint8_t*)mmap( NULL, m_nMapSize, PROT_READ, MAP_SHARED, m_nFd, 0 );
+
+		if( MAP_FAILED == m_pMap )
+		{
+			printf( "WARNING: GlyphDiskCache::Map() mmap( %s ) failed.\n", m_strFilename.c_str() );
+			m_pMap		= NULL;
+			m_nMapSize	= 0;
+			m_nFileSize	= 0;
+			return	false;
+		}
+
+		m_nFileSize	= Scan();
+		return	true;
+	}
+
+	// Write the records keep() accepts, up to limit bytes, to a new file and
+	// rename() it over m_strFilename. m_pMap and m_iIndex stay on the old file.
+	template<typename Keep>
+	bool	Rebuild( size_t limit, Keep keep )
+	{
+		std::string								strTemp		= m_strFilename + ".tmp";
+		std::unordered_map<Key,size_t,KeyHash>	iAppended;
+		size_t									pos			= sizeof(Header);
+		bool									isOk;
+		int										fd;
+
+		fd	= ::open( strTemp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644 );
+		if( fd < 0 )
+		{
+			printf( "WARNING: GlyphDiskCache::Rebuild() open( %s ) failed.\n", strTemp.c_str() );
+			return	false;
+		}
+
+		// locked before it has the name, a starting instance can not take it.
+		isOk	= (0 == flock( fd, LOCK_EX | LOCK_NB )) && (sizeof(Header) == pwrite( fd, &GetHeader(), sizeof(Header), 0 ));
+
+		for( auto it = m_iIndex.begin(); isOk && (it != m_iIndex.end()); ++it )
+		{
+			const Record*	rec		= (const Record*)&m_pMap[ it->second ];
+			size_t			size	= GetSize( *rec );
+
+			if( keep( *rec ) && ((pos + size) <= limit) )
+			{
+				isOk	= (ssize_t)size == pwrite( fd, rec, size, pos );
+				pos		+= size;
+			}
+		}
+
+		// appended in this run, not in the map.
+		for( auto it = m_iAppended.begin(); isOk && (it != m_iAppended.end()); ++it )
+		{
+			Record	rec;
+
+			isOk	= sizeof(rec) == pread( m_nFd, &rec, sizeof(rec), it->second );
+
+			size_t	size	= GetSize( rec );
+
+			if( isOk && keep( rec ) && ((pos + size) <= limit) )
+			{
+				m_iBuffer.resize( size );
+
+				isOk	= ((ssize_t)size == pread( m_nFd, m_iBuffer.data(), size, it->second )) &&
+						  ((ssize_t)size == pwrite( fd, m_iBuffer.data(), size, pos ));
+
+				iAppended[ it->first ]	= pos;
+				pos						+= size;
+			}
+		}
+
+		if( !isOk || (0 != rename( strTemp.c_str(), m_strFilename.c_str() )) )
+		{
+			printf( "WARNING: GlyphDiskCache::Rebuild() %s failed.\n", strTemp.c_str() );
+			::close( fd );
+			unlink( strTemp.c_str() );
+			return	false;
+		}
+
+		// the lock of the old file goes with it, readers keep their map.
+		::close( m_nFd );
+
+		m_nFd		= fd;
+		m_nFileSize	= pos;
+		m_iAppended.swap( iAppended );
+
+		return	true;
+	}
+
+	static	uint32_t	Check( const Record& rec, const uint8_t* bitmap, size_t bytes )
+	{
+		Record		tmp	= rec;
+
+		tmp.check	= 0;
+
+		uint64_t	h	= FontRegistry::Hash( &tmp, sizeof(tmp) );
+
+		h	= FontRegistry::Hash( bitmap, bytes, h );
+
+		return	(uint32_t)(h ^ (h >> 32));
+	}
+
+	// Index the records of the map, returns the size of the valid part.
+	size_t	Scan()
+	{
+		size_t	pos	= sizeof(Header);
+
+		while( (pos + sizeof(Record)) <= m_nMapSize )
+		{
+			const Record*	rec		= (const Record*)&m_pMap[ pos ];
+			size_t			bytes	= (size_t)rec->width * rec->rows;
+			size_t			size	= sizeof(Record) + Align( bytes );
+
+			if( (m_nMapSize < (pos + size)) || (rec->check != Check( *rec, (const uint8_t*)(rec + 1), bytes )) )
+			{
+				break;
+			}
+
+			m_iIndex[ rec->key ]	= pos;
+			pos	+= size;
+		}
+
+		return	pos;
+	}
+
+protected:
+	int											m_nFd;
+	uint8_t*									m_pMap;
+	size_t										m_nMapSize;
+	size_t										m_nFileSize;	// valid records, append position
+	bool										m_isWritable;
+	bool										m_isRebuilt;	// Append() rebuilt once
+	std::string									m_strFilename;
+	uint64_t									m_nHits;
+	uint64_t									m_nMisses;
+
+	std::unordered_map<Key,size_t,KeyHash>		m_iIndex;		// record offsets in m_pMap
+	std::unordered_map<Key,size_t,KeyHash>		m_iAppended;	// record offsets in m_nFd
+	std::unordered_set<uint64_t>				m_iFonts;		// fonts given to Open() or used, IsUsed()
+	std::vector<uint8_t>						m_iBuffer;
+	std::mutex									m_iMutex;		// Find(), Append()
+};
+
+#endif	// __IMG_GLYPH_DISK_CACHE_H_INCLUDED__
@@ -2,8 +2,22 @@
 #define	__IMG_HALFTONE_H_INCLUDED__
 
 #include <stdint.h>
+#include <stdio.h>
+#include <string.h>
 #include <math.h>
 #include <vector>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include "multithread_tools.h"
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define	IMAGE_HALFTONE_NEON	1
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#define	IMAGE_HALFTONE_SSE2	1
+#include <emmintrin.h>
+#endif
 
 namespace ImageHalftoning
 {
@@ -41,167 +55,458 @@ namespace ImageHalftoning
 	};
 
 
-	void ErrDiff_FloydSteinberg( uint8_t * image, int stride, int width, int height )
+	//	Diffusion kernels.
+	//
+	//	A kernel is a compile-time table of taps (dx, dy, weight) and a divisor.
+	//	ErrDiff<KERNEL>() generates the inner loop from it and works on a padded
+	//	ring of rows, so the taps need no bounds checks. Error terms keep the
+	//	truncating division and the per-tap clamp of ErrDiffAdd, so the result
+	//	is the same as the original per-pixel implementation.
+
+	template<int DX, int DY, int W>
+	struct ErrDiffTap
 	{
-		ErrDiffAdd	iEDA( image, stride, width, height );
-		
-		for( int y = 0; y < height; y++ )
+		enum
 		{
-			uint8_t* line	= image + stride * y;
+			dx		= DX,
+			dy		= DY,
+			weight	= W,
+			reach	= DX < 0 ? -DX : DX,
+		};
+	};
 
-			for( int x = 0; x < width; x++ )
-			{
-				int		c	= line[x];
-				int		e	= c > 127 ? c - 255 : c;
-				
-				line[x]	= c > 127 ? 255 : 0;
+	constexpr int	ErrDiffMax( int a )
+	{
+		return	a;
+	}
 
-				//	-		*		7/16
-				//	3/16	5/16	1/16
-				iEDA( x+1, y+0, e * 7 / 16 );
-		
-				iEDA( x-1, y+1, e * 3 / 16 );
-				iEDA( x+0, y+1, e * 5 / 16 );
-				iEDA( x+1, y+1, e * 1 / 16 );
-			}
-		}
+	template<class... T>
+	constexpr int	ErrDiffMax( int a, int b, T... rest )
+	{
+		return	ErrDiffMax( a < b ? b : a, rest... );
 	}
 
+	template<int DIV, class... TAPS>
+	struct ErrDiffKernel
+	{
+		enum
+		{
+			divisor	= DIV,
+			taps	= sizeof...(TAPS),
+			reach	= ErrDiffMax( TAPS::reach... ),		// largest |dx|
+			rows	= ErrDiffMax( TAPS::dy... ) + 1,	// current row + rows below
+		};
 
-	void    ErrDiff_Burkes( uint8_t* image, int stride, int width, int height )
+		// rows[dy] points to pixel 0 of row (y + dy).
+		static	inline	void	Diffuse( uint8_t* const* line, int x, int e )
+		{
+			int		dummy[]	= { ( Add( line[TAPS::dy][ x + TAPS::dx ], e * TAPS::weight / DIV ), 0 )... };
+
+			(void)dummy;
+		}
+
+		static	inline	void	Add( uint8_t& data, int value )
+		{
+			value	+= data;
+
+			data	= 0 == (value >> 8) ? value : (value >> 8) < 0 ? 0 : 255;
+		}
+	};
+
+	//	-		*		7/16
+	//	3/16	5/16	1/16
+	typedef	ErrDiffKernel< 16,
+				ErrDiffTap< 1,0,7>,
+				ErrDiffTap<-1,1,3>, ErrDiffTap< 0,1,5>, ErrDiffTap< 1,1,1> >	ErrDiffKernel_FloydSteinberg;
+
+	//	-		-		*		4/16	2/16
+	//	1/16	2/16	4/16	2/16	1/16
+	typedef	ErrDiffKernel< 16,
+				ErrDiffTap< 1,0,4>, ErrDiffTap< 2,0,2>,
+				ErrDiffTap<-2,1,1>, ErrDiffTap<-1,1,2>, ErrDiffTap< 0,1,4>, ErrDiffTap< 1,1,2>, ErrDiffTap< 2,1,1> >	ErrDiffKernel_Burkes;
+
+	//	-		-		*		8/42	4/42
+	//	2/42	4/42	8/42	4/42	2/42
+	//	1/42	2/42	4/42	2/42	1/42
+	typedef	ErrDiffKernel< 42,
+				ErrDiffTap< 1,0,8>, ErrDiffTap< 2,0,4>,
+				ErrDiffTap<-2,1,2>, ErrDiffTap<-1,1,4>, ErrDiffTap< 0,1,8>, ErrDiffTap< 1,1,4>, ErrDiffTap< 2,1,2>,
+				ErrDiffTap<-2,2,1>, ErrDiffTap<-1,2,2>, ErrDiffTap< 0,2,4>, ErrDiffTap< 1,2,2>, ErrDiffTap< 2,2,1> >	ErrDiffKernel_Stucki;
+
+	//	-		-		*		1/8		1/8
+	//	-		1/8		1/8		1/8		-
+	//	-		-		1/8		-		-
+	typedef	ErrDiffKernel< 8,
+				ErrDiffTap< 1,0,1>, ErrDiffTap< 2,0,1>,
+				ErrDiffTap<-1,1,1>, ErrDiffTap< 0,1,1>, ErrDiffTap< 1,1,1>,
+				ErrDiffTap< 0,2,1> >	ErrDiffKernel_Atkinson;
+
+	//	-		-		*		5/32	3/32
+	//	2/32	4/32	5/32	4/32	2/32
+	//	-		2/32	3/32	2/32	-
+	typedef	ErrDiffKernel< 32,
+				ErrDiffTap< 1,0,5>, ErrDiffTap< 2,0,3>,
+				ErrDiffTap<-2,1,2>, ErrDiffTap<-1,1,4>, ErrDiffTap< 0,1,5>, ErrDiffTap< 1,1,4>, ErrDiffTap< 2,1,2>,
+				ErrDiffTap<-1,2,2>, ErrDiffTap< 0,2,3>, ErrDiffTap< 1,2,2> >	ErrDiffKernel_Sierra;
+
+	//	-		-		*		7/48	5/48
+	//	3/48	5/48	7/48	5/48	3/48
+	//	1/48	3/48	5/48	3/48	1/48
+	typedef	ErrDiffKernel< 48,
+				ErrDiffTap< 1,0,7>, ErrDiffTap< 2,0,5>,
+				ErrDiffTap<-2,1,3>, ErrDiffTap<-1,1,5>, ErrDiffTap< 0,1,7>, ErrDiffTap< 1,1,5>, ErrDiffTap< 2,1,3>,
+				ErrDiffTap<-2,2,1>, ErrDiffTap<-1,2,3>, ErrDiffTap< 0,2,5>, ErrDiffTap< 1,2,3>, ErrDiffTap< 2,2,1> >	ErrDiffKernel_JarvisJudiceNinke;
+
+
+	template<class KERNEL>
+	inline	void	ErrDiffLine( uint8_t* const* line, int width )
 	{
-		ErrDiffAdd	iEDA( image, stride, width, height );
-		
-		for( int y = 0; y < height; y++ )
+		uint8_t*	dst	= line[0];
+
+		for( int x = 0; x < width; x++ )
 		{
-			uint8_t* line	= image + stride * y;
+			int		c	= dst[x];
+			int		e	= c > 127 ? c - 255 : c;
 
-			for( int x = 0; x < width; x++ )
-			{
-				int		c	= line[x];
-				int		e	= c > 127 ? c - 255 : c;
-				
-				line[x]	= c > 127 ? 255 : 0;
-
-				//	-		-		*		4/16	2/16
-				//	1/16	2/16	4/16	2/16	1/16
-				iEDA( x+1, y+0, e * 4 / 16 );
-				iEDA( x+2, y+0, e * 2 / 16 );
-		
-				iEDA( x-2, y+1, e * 1 / 16 );
-				iEDA( x-1, y+1, e * 2 / 16 );
-				iEDA( x+0, y+1, e * 4 / 16 );
-				iEDA( x+1, y+1, e * 2 / 16 );
-				iEDA( x+2, y+1, e * 1 / 16 );
-			}
+			dst[x]	= c > 127 ? 255 : 0;
+
+			KERNEL::Diffuse( line, x, e );
 		}
 	}
 
 
-	void    ErrDiff_Stucki( uint8_t * image, int stride, int width, int height )
+	template<class KERNEL>
+	void	ErrDiff( uint8_t* image, int stride, int width, int height )
 	{
-		ErrDiffAdd	iEDA( image, stride, width, height );
-		
+		const int	rows	= KERNEL::rows;
+		const int	reach	= KERNEL::reach;
+		const int	pitch	= width + reach * 2;
+		static thread_local	std::vector<uint8_t>	iRing;
+
+		if( (width <= 0) || (height <= 0) )
+		{
+			return;
+		}
+
+		iRing.resize( pitch * rows );
+
+		auto	slot	= [&]( int y )
+		{
+			return	&iRing[ pitch * (y % rows) + reach ];
+		};
+
+		for( int y = 0; (y < rows) && (y < height); y++ )
+		{
+			memcpy( slot( y ), image + stride * y, width );
+		}
+
 		for( int y = 0; y < height; y++ )
 		{
-			uint8_t* line	= image + stride * y;
+			uint8_t*	line[rows];
 
-			for( int x = 0; x < width; x++ )
+			for( int dy = 0; dy < rows; dy++ )
 			{
-				int		c	= line[x];
-				int		e	= c > 127 ? c - 255 : c;
-				
-				line[x]	= c > 127 ? 255 : 0;
+				line[dy]	= slot( y + dy );
+			}
 
-				//	-		-		*		8/42	4/42
-				//	2/42	4/42	8/42	4/42	2/42
-				//	1/42	2/42	4/42	2/42	1/42
-				iEDA( x+1, y+0, e * 8 / 42 );
-				iEDA( x+2, y+0, e * 4 / 42 );
-		
-				iEDA( x-2, y+1, e * 2 / 42 );
-				iEDA( x-1, y+1, e * 4 / 42 );
-				iEDA( x+0, y+1, e * 8 / 42 );
-				iEDA( x+1, y+1, e * 4 / 42 );
-				iEDA( x+2, y+1, e * 2 / 42 );
-		
-				iEDA( x-2, y+2, e * 1 / 42 );
-				iEDA( x-1, y+2, e * 2 / 42 );
-				iEDA( x+0, y+2, e * 4 / 42 );
-				iEDA( x+1, y+2, e * 2 / 42 );
-				iEDA( x+2, y+2, e * 1 / 42 );
+			ErrDiffLine<KERNEL>( line, width );
+
+			memcpy( image + stride * y, line[0], width );
+
+			if( (y + rows) < height )
+			{
+				memcpy( line[0], image + stride * (y + rows), width );
 			}
 		}
 	}
 
 
+	void    ErrDiff_FloydSteinberg( uint8_t * image, int stride, int width, int height )
+	{
+		ErrDiff<ErrDiffKernel_FloydSteinberg>( image, stride, width, height );
+	}
+
+	void    ErrDiff_Burkes( uint8_t* image, int stride, int width, int height )
+	{
+		ErrDiff<ErrDiffKernel_Burkes>( image, stride, width, height );
+	}
+
+	void    ErrDiff_Stucki( uint8_t * image, int stride, int width, int height )
+	{
+		ErrDiff<ErrDiffKernel_Stucki>( image, stride, width, height );
+	}
+
 	void    ErrDiff_Atkinson( uint8_t * image, int stride, int width, int height )
 	{
-		ErrDiffAdd	iEDA( image, stride, width, height );
-		
+		ErrDiff<ErrDiffKernel_Atkinson>( image, stride, width, height );
+	}
+
+	void    ErrDiff_Sierra( uint8_t * image, int stride, int width, int height )
+	{
+		ErrDiff<ErrDiffKernel_Sierra>( image, stride, width, height );
+	}
+
+	void    ErrDiff_JarvisJudiceNinke( uint8_t * image, int stride, int width, int height )
+	{
+		ErrDiff<ErrDiffKernel_JarvisJudiceNinke>( image, stride, width, height );
+	}
+
+
+	//	Wavefront-parallel error diffusion.
+	//
+	//	The image is copied into a padded work buffer and rows are handed out
+	//	in order to the worker threads. Row y may process pixel x only after
+	//	row y-1 has finished pixel x + reach*2, so every pixel receives its
+	//	(clamped) error terms in exactly the serial order and the result is
+	//	bit-identical to ErrDiff<KERNEL>().
+	//
+	//	Only used where it wins, otherwise ErrDiff<KERNEL>() runs:
+	//	-	kernels of WAVEFRONT_MIN_TAPS taps or more (Burkes, Stucki).
+	//		PerfTest_ImageConvert showed no gain for Floyd-Steinberg (4 taps)
+	//		and a loss for Atkinson (6 taps, shifts only): too little work per
+	//		pixel to cover the polling of the row above.
+	//	-	images of at least WAVEFRONT_MIN_WIDTH x WAVEFRONT_MIN_HEIGHT. A
+	//		narrow row keeps the threads waiting on the lag most of the time.
+	//	Re-check both with PerfTest_ImageConvert on the target board.
+	//	The threads are CWorkerPool::GetDefault(), not created per call.
+
+	enum
+	{
+		WAVEFRONT_MIN_TAPS		= 7,
+		WAVEFRONT_MIN_WIDTH		= 256,
+		WAVEFRONT_MIN_HEIGHT	= 64,
+	};
+
+	template<class KERNEL>
+	void	ErrDiffWavefront( uint8_t* image, int stride, int width, int height, int nThreads )
+	{
+		const int		rows		= KERNEL::rows;
+		const int		reach		= KERNEL::reach;
+		const int		taps		= KERNEL::taps;
+		const int		LAG			= reach * 2 + 1;
+		const int		PUBLISH		= 32;
+		const int		pitch		= width + reach * 2;
+
+		static thread_local	std::vector<uint8_t>				iWork;
+		static thread_local	std::unique_ptr<std::atomic<int>[]>	iProgress;
+		static thread_local	int									nProgress	= 0;
+
+		if( 0 == nThreads )
+		{
+			nThreads	= CMultiThreadTools::GetProcessorCount();
+		}
+
+		nThreads	= height < nThreads ? height : nThreads;
+
+		if( (nThreads <= 1) || (taps < WAVEFRONT_MIN_TAPS) || (width < WAVEFRONT_MIN_WIDTH) || (height < WAVEFRONT_MIN_HEIGHT) )
+		{
+			ErrDiff<KERNEL>( image, stride, width, height );
+			return;
+		}
+
+		// Padded work image, (rows - 1) extra rows at the bottom.
+		iWork.assign( pitch * (height + rows - 1), 0 );
+
+		// Number of finished pixels per row.
+		if( nProgress < height )
+		{
+			iProgress.reset( new std::atomic<int>[ height ] );
+			nProgress	= height;
+		}
+
+		// The buffers belong to the calling thread, the workers see them through these.
+		uint8_t*			pWork		= iWork.data();
+		std::atomic<int>*	pProgress	= iProgress.get();
+		std::atomic<int>	nNextRow( 0 );
+
 		for( int y = 0; y < height; y++ )
 		{
-			uint8_t* line	= image + stride * y;
+			memcpy( &pWork[ pitch * y + reach ], image + stride * y, width );
+			pProgress[y].store( 0, std::memory_order_relaxed );
+		}
 
-			for( int x = 0; x < width; x++ )
+		auto	func	= [&]()
+		{
+			for(;;)
 			{
-				int		c	= line[x];
-				int		e	= c > 127 ? c - 255 : c;
-				
-				line[x]	= c > 127 ? 255 : 0;
-
-				//	-		-		*		1/8		1/8
-				//	-		1/8		1/8		1/8		-
-				//	-		-		1/8		-		-
-				iEDA( x+1, y+0, e * 1 / 8 );
-				iEDA( x+2, y+0, e * 1 / 8 );
-		
-				iEDA( x-1, y+1, e * 1 / 8 );
-				iEDA( x+0, y+1, e * 1 / 8 );
-				iEDA( x+1, y+1, e * 1 / 8 );
-
-				iEDA( x+0, y+2, e * 1 / 8 );
+				int		y	= nNextRow.fetch_add( 1 );
+
+				if( height <= y )
+				{
+					break;
+				}
+
+				uint8_t*			line[rows];
+				std::atomic<int>*	above	= 0 < y ? &pProgress[y-1] : NULL;
+				int					nAbove	= NULL != above ? 0 : width;
+
+				for( int dy = 0; dy < rows; dy++ )
+				{
+					line[dy]	= &pWork[ pitch * (y + dy) + reach ];
+				}
+
+				for( int x = 0; x < width; x++ )
+				{
+					int		need	= (x + LAG) < width ? (x + LAG) : width;
+
+					while( nAbove < need )
+					{
+						nAbove	= above->load( std::memory_order_acquire );
+
+						if( nAbove < need )
+						{
+							std::this_thread::yield();
+						}
+					}
+
+					int		c	= line[0][x];
+					int		e	= c > 127 ? c - 255 : c;
+
+					line[0][x]	= c > 127 ? 255 : 0;
+
+					KERNEL::Diffuse( line, x, e );
+
+					if( 0 == ((x + 1) % PUBLISH) )
+					{
+						pProgress[y].store( x + 1, std::memory_order_release );
+					}
+				}
+
+				memcpy( image + stride * y, line[0], width );
+
+				pProgress[y].store( width, std::memory_order_release );
 			}
-		}
+		};
+
+		CWorkerPool::GetDefault().Execute( nThreads, func );
 	}
 
 
-	void    ErrDiff_LinearFloydSteinberg( uint8_t * image, int stride, int width, int height )
+	void	ErrDiffParallel_FloydSteinberg( uint8_t* image, int stride, int width, int height, int nThreads )
+	{
+		ErrDiffWavefront<ErrDiffKernel_FloydSteinberg>( image, stride, width, height, nThreads );
+	}
+
+	void	ErrDiffParallel_Burkes( uint8_t* image, int stride, int width, int height, int nThreads )
 	{
-		int					shift	= 20;
-		int					gamma[256];
-		std::vector<int>	data(width*height);
+		ErrDiffWavefront<ErrDiffKernel_Burkes>( image, stride, width, height, nThreads );
+	}
+
+	void	ErrDiffParallel_Stucki( uint8_t* image, int stride, int width, int height, int nThreads )
+	{
+		ErrDiffWavefront<ErrDiffKernel_Stucki>( image, stride, width, height, nThreads );
+	}
+
+	void	ErrDiffParallel_Atkinson( uint8_t* image, int stride, int width, int height, int nThreads )
+	{
+		ErrDiffWavefront<ErrDiffKernel_Atkinson>( image, stride, width, height, nThreads );
+	}
+
+	// All processors.
+	void	ErrDiffParallel_FloydSteinberg( uint8_t* image, int stride, int width, int height )
+	{
+		ErrDiffParallel_FloydSteinberg( image, stride, width, height, 0 );
+	}
+
+	void	ErrDiffParallel_Burkes( uint8_t* image, int stride, int width, int height )
+	{
+		ErrDiffParallel_Burkes( image, stride, width, height, 0 );
+	}
+
+	void	ErrDiffParallel_Stucki( uint8_t* image, int stride, int width, int height )
+	{
+		ErrDiffParallel_Stucki( image, stride, width, height, 0 );
+	}
+
+	void	ErrDiffParallel_Atkinson( uint8_t* image, int stride, int width, int height )
+	{
+		ErrDiffParallel_Atkinson( image, stride, width, height, 0 );
+	}
+
+	// 2.2 gamma to linear light, (1 << SHIFT) - 1 = white.
+	class LinearGamma
+	{
+	public:
+		enum
+		{
+			SHIFT	= 20,
+		};
 
-		for( int i = 0; i < 256; i++ )
+		static	const int*	GetTable()
 		{
-			gamma[i]	= (int)(pow( i / 255.0, 2.2 ) * ((1 << shift) - 1));
+			static	const LinearGamma	iGamma;
+
+			return	iGamma.m_nTable;
 		}
-		
-		for( int y = 0; y < height; y++ )
+
+		static	void	Convert( int* dst, const uint8_t* src, int width, const int* gamma )
 		{
-			uint8_t*	src_line	= image + stride * y;
-			int *		dst_line	= &data.data()[ width * y ];
-			int			x			= 0;
+			int		x	= 0;
 
 			for( ; (x+4) <= width; x += 4 )
 			{
-				dst_line[x+0]	= gamma[ src_line[x+0] ];
-				dst_line[x+1]	= gamma[ src_line[x+1] ];
-				dst_line[x+2]	= gamma[ src_line[x+2] ];
-				dst_line[x+3]	= gamma[ src_line[x+3] ];
+				dst[x+0]	= gamma[ src[x+0] ];
+				dst[x+1]	= gamma[ src[x+1] ];
+				dst[x+2]	= gamma[ src[x+2] ];
+				dst[x+3]	= gamma[ src[x+3] ];
 			}
 
 			for( ; x < width; x++ )
 			{
-				dst_line[x+0]	= gamma[ src_line[x+0] ];
+				dst[x+0]	= gamma[ src[x+0] ];
 			}
 		}
 
+	protected:
+		LinearGamma()
+		{
+			for( int i = 0; i < 256; i++ )
+			{
+				m_nTable[i]	= (int)(pow( i / 255.0, 2.2 ) * ((1 << SHIFT) - 1));
+			}
+		}
+
+	protected:
+		int		m_nTable[256];
+	};
+
+
+	//	Streaming error diffusion in linear light.
+	//	Only a ring of error rows is kept, so there is no per-call full-frame buffer.
+	//
+	//	const uint8_t* load( int y, uint8_t* buf )	: returns gray row y. (may fill and return buf)
+	//	void store( int y, const uint8_t* line )	: row y is finished. line is 0 or 255.
+	//
+	//	Rows are loaded in order, and row y is stored before row y+3 is loaded.
+
+	template<class LOAD_ROW, class STORE_ROW>
+	void    ErrDiffStream_LinearFloydSteinberg( int width, int height, LOAD_ROW load, STORE_ROW store )
+	{
+		const int					shift	= LinearGamma::SHIFT;
+		const int*					gamma	= LinearGamma::GetTable();
+		static thread_local	std::vector<int>		iRing;
+		static thread_local	std::vector<uint8_t>	iLine;
+
+		if( (width <= 0) || (height <= 0) )
+		{
+			return;
+		}
+
+		iRing.resize( width * 2 );
+		iLine.resize( width );
+
+		LinearGamma::Convert( &iRing[0], load( 0, iLine.data() ), width, gamma );
 
 		for( int y = 0; y < height; y++ )
 		{
-			int*		line		= &data.data()[ width * y ];
-			uint8_t*	dst_line	= image + stride * y;
+			int*		line		= &iRing[ width * ((y+0) & 1) ];
+			int*		lineN		= &iRing[ width * ((y+1) & 1) ];
+			uint8_t*	dst_line	= iLine.data();
+
+			if( (y+1) < height )
+			{
+				LinearGamma::Convert( lineN, load( y+1, iLine.data() ), width, gamma );
+			}
 
 			for( int x = 0; x < width; x++ )
 			{
@@ -216,52 +521,50 @@ namespace ImageHalftoning
 
 				if( (y+1) < height )
 				{
-					int*	lineN	= line + width;
-
 					if( 0 <= (x-1) )	lineN[x-1]	+= e * 3 / 16;
 										lineN[x  ]	+= e * 5 / 16;
 					if( (x+2) < width ) lineN[x+1]	+= e * 1 / 16;
 				}
 			}
+
+			store( y, dst_line );
 		}
 	}
-	
-	void    ErrDiff_LinearStucki( uint8_t * image, int stride, int width, int height )
+
+	template<class LOAD_ROW, class STORE_ROW>
+	void    ErrDiffStream_LinearStucki( int width, int height, LOAD_ROW load, STORE_ROW store )
 	{
-		int					shift	= 20;
-		int					gamma[256];
-		std::vector<int>	data(width*height);
+		const int					shift	= LinearGamma::SHIFT;
+		const int*					gamma	= LinearGamma::GetTable();
+		static thread_local	std::vector<int>		iRing;
+		static thread_local	std::vector<uint8_t>	iLine;
 
-		for( int i = 0; i < 256; i++ )
+		if( (width <= 0) || (height <= 0) )
 		{
-			gamma[i]	= (int)(pow( i / 255.0, 2.2 ) *((1 << shift) - 1));
+			return;
 		}
-		
-		for( int y = 0; y < height; y++ )
-		{
-			uint8_t*	src_line	= image + stride * y;
-			int *		dst_line	= &data.data()[ width * y ];
-			int			x			= 0;
 
-			for( ; (x+4) <= width; x += 4 )
-			{
-				dst_line[x+0]	= gamma[ src_line[x+0] ];
-				dst_line[x+1]	= gamma[ src_line[x+1] ];
-				dst_line[x+2]	= gamma[ src_line[x+2] ];
-				dst_line[x+3]	= gamma[ src_line[x+3] ];
-			}
+		iRing.resize( width * 3 );
+		iLine.resize( width );
 
-			for( ; x < width; x++ )
-			{
-				dst_line[x+0]	= gamma[ src_line[x+0] ];
-			}
-		}
+		LinearGamma::Convert( &iRing[0], load( 0, iLine.data() ), width, gamma );
 
+		if( 1 < height )
+		{
+			LinearGamma::Convert( &iRing[width], load( 1, iLine.data() ), width, gamma );
+		}
 
 		for( int y = 0; y < height; y++ )
 		{
-			int*		line		= &data.data()[ width * y ];
-			uint8_t*	dst_line	= image + stride * y;
+			int*		line		= &iRing[ width * ((y+0) % 3) ];
+			int*		lineN1		= &iRing[ width * ((y+1) % 3) ];
+			int*		lineN2		= &iRing[ width * ((y+2) % 3) ];
+			uint8_t*	dst_line	= iLine.data();
+
+			if( (y+2) < height )
+			{
+				LinearGamma::Convert( lineN2, load( y+2, iLine.data() ), width, gamma );
+			}
 
 			for( int x = 0; x < width; x++ )
 			{
@@ -278,30 +581,59 @@ namespace ImageHalftoning
 
 				if( (y+1) < height )
 				{
-					int*	lineN	= line + width;
-
-					if( 0 <= (x-2) )	lineN[x-2]	+= e * 2 / 42;
-					if( 0 <= (x-1) )	lineN[x-1]	+= e * 4 / 42;
-										lineN[x  ]	+= e * 8 / 42;
-					if( (x+2) < width ) lineN[x+1]	+= e * 4 / 42;
-					if( (x+2) < width ) lineN[x+2]	+= e * 2 / 42;
+					if( 0 <= (x-2) )	lineN1[x-2]	+= e * 2 / 42;
+					if( 0 <= (x-1) )	lineN1[x-1]	+= e * 4 / 42;
+										lineN1[x  ]	+= e * 8 / 42;
+					if( (x+2) < width ) lineN1[x+1]	+= e * 4 / 42;
+					if( (x+2) < width ) lineN1[x+2]	+= e * 2 / 42;
 				}
 
 				if( (y+2) < height )
 				{
-					int*	lineN	= line + width * 2;
-
-					if( 0 <= (x-2) )	lineN[x-2]	+= e * 1 / 42;
-					if( 0 <= (x-1) )	lineN[x-1]	+= e * 2 / 42;
-										lineN[x  ]	+= e * 4 / 42;
-					if( (x+2) < width ) lineN[x+1]	+= e * 2 / 42;
-					if( (x+2) < width ) lineN[x+2]	+= e * 1 / 42;
+					if( 0 <= (x-2) )	lineN2[x-2]	+= e * 1 / 42;
+					if( 0 <= (x-1) )	lineN2[x-1]	+= e * 2 / 42;
+										lineN2[x  ]	+= e * 4 / 42;
+					if( (x+2) < width ) lineN2[x+1]	+= e * 2 / 42;
+					if( (x+2) < width ) lineN2[x+2]	+= e * 1 / 42;
 				}
 			}
+
+			store( y, dst_line );
 		}
 	}
 
 
+	void    ErrDiff_LinearFloydSteinberg( uint8_t * image, int stride, int width, int height )
+	{
+		ErrDiffStream_LinearFloydSteinberg(
+			width,
+			height,
+			[&]( int y, uint8_t* )->const uint8_t*
+			{
+				return	image + stride * y;
+			},
+			[&]( int y, const uint8_t* line )
+			{
+				memcpy( image + stride * y, line, width );
+			} );
+	}
+	
+	void    ErrDiff_LinearStucki( uint8_t * image, int stride, int width, int height )
+	{
+		ErrDiffStream_LinearStucki(
+			width,
+			height,
+			[&]( int y, uint8_t* )->const uint8_t*
+			{
+				return	image + stride * y;
+			},
+			[&]( int y, const uint8_t* line )
+			{
+				memcpy( image + stride * y, line, width );
+			} );
+	}
+
+
 	void PatternDither_2x2( uint8_t * image, int stride, int width, int height )
 	{
 		for( int y = 0; (y+2) <= height; y += 2)
@@ -359,6 +691,334 @@ namespace ImageHalftoning
 			} 
 		}
 	}
+
+	//	Threshold matrix for ordered dithering.
+	//
+	//	The matrix is tiled over the whole screen. Every row is stored with the
+	//	period repeated up to (size + 16) bytes, so 16 thresholds can be loaded
+	//	from any phase without wrapping.
+	class ThresholdMatrix
+	{
+	public:
+		enum
+		{
+			SIMD_WIDTH	= 16,
+		};
+
+		// iRanks : size x size, every value in [0, size*size).
+		ThresholdMatrix( int nSize, const std::vector<int>& iRanks )
+		{
+			if( (nSize <= 0) || ((int)iRanks.size() != (nSize * nSize)) )
+			{
+				printf( "ERROR: ThresholdMatrix() Invalid size %d.\n", nSize );
+				throw	"ThresholdMatrix() INVALID size";
+			}
+
+			m_nSize		= nSize;
+			m_nPitch	= nSize + SIMD_WIDTH;
+			m_iTable.resize( m_nPitch * nSize );
+
+			for( int y = 0; y < nSize; y++ )
+			{
+				for( int x = 0; x < m_nPitch; x++ )
+				{
+					int		r	= iRanks[ nSize * y + (x % nSize) ];
+
+					// 0 never lights a pixel, 255 always does.
+					m_iTable[ m_nPitch * y + x ]	= (uint8_t)( ((r * 2 + 1) * 255) / (nSize * nSize * 2) );
+				}
+			}
+		}
+
+		int		GetSize() const
+		{
+			return	m_nSize;
+		}
+
+		// Thresholds of absolute screen row y, starting at absolute column x.
+		// At least (size + 16 - (x % size)) values are readable.
+		const uint8_t*	GetRow( int x, int y ) const
+		{
+			return	&m_iTable[ m_nPitch * Mod( y ) + Mod( x ) ];
+		}
+
+		int		Mod( int v ) const
+		{
+			v	%= m_nSize;
+
+			return	v < 0 ? v + m_nSize : v;
+		}
+
+		// Bayer 2x2, 4x4, 8x8 and 16x16.
+		static	const ThresholdMatrix&	Bayer( int n )
+		{
+			static	const ThresholdMatrix	iBayer2( 2, BayerRanks( 2 ) );
+			static	const ThresholdMatrix	iBayer4( 4, BayerRanks( 4 ) );
+			static	const ThresholdMatrix	iBayer8( 8, BayerRanks( 8 ) );
+			static	const ThresholdMatrix	iBayer16( 16, BayerRanks( 16 ) );
+
+			switch( n )
+			{
+			case 2:		return	iBayer2;
+			case 4:		return	iBayer4;
+			case 8:		return	iBayer8;
+			case 16:	return	iBayer16;
+			}
+
+			printf( "ERROR: ThresholdMatrix::Bayer() Invalid size %d.\n", n );
+			throw	"ThresholdMatrix::Bayer() INVALID size";
+		}
+
+		// Tileable 32x32 blue noise (void-and-cluster), generated on first use.
+		static	const ThresholdMatrix&	BlueNoise()
+		{
+			static	const ThresholdMatrix	iBlueNoise( 32, VoidAndClusterRanks( 32 ) );
+
+			return	iBlueNoise;
+		}
+
+		static	std::vector<int>	BayerRanks( int n )
+		{
+			std::vector<int>	iRanks( 1, 0 );
+
+			for( int size = 1; size < n; size *= 2 )
+			{
+				std::vector<int>	iNext( size * size * 4 );
+
+				for( int y = 0; y < size; y++ )
+				{
+					for( int x = 0; x < size; x++ )
+					{
+						int		r	= iRanks[ size * y + x ] * 4;
+
+						iNext[ (size*2) * (y     ) + x        ]	= r + 0;
+						iNext[ (size*2) * (y     ) + x + size ]	= r + 2;
+						iNext[ (size*2) * (y+size) + x        ]	= r + 3;
+						iNext[ (size*2) * (y+size) + x + size ]	= r + 1;
+					}
+				}
+
+				iRanks.swap( iNext );
+			}
+
+			return	iRanks;
+		}
+
+		// Ulichney's void-and-cluster method on a torus (sigma = 1.5).
+		static	std::vector<int>	VoidAndClusterRanks( int n )
+		{
+			const int			count	= n * n;
+			std::vector<float>	iGauss( count );
+			std::vector<float>	iEnergy( count, 0.0f );
+			std::vector<char>	iPattern( count, 0 );
+			std::vector<int>	iRanks( count, 0 );
+			uint32_t			seed	= 0x2545F491;
+
+			for( int y = 0; y < n; y++ )
+			{
+				for( int x = 0; x < n; x++ )
+				{
+					int		dx	= x < (n / 2) ? x : n - x;
+					int		dy	= y < (n / 2) ? y : n - y;
+
+					iGauss[ n * y + x ]	= (float)exp( -(dx * dx + dy * dy) / (2.0 * 1.5 * 1.5) );
+				}
+			}
+
+			auto	Splat	= [&]( int pos, float sign )
+			{
+				int		px	= pos % n;
+				int		py	= pos / n;
+
+				for( int y = 0; y < n; y++ )
+				{
+					const float*	g	= &iGauss[ n * ((y - py + n) % n) ];
+					float*			e	= &iEnergy[ n * y ];
+
+					for( int x = 0; x < n; x++ )
+					{
+						e[x]	+= sign * g[ (x - px + n) % n ];
+					}
+				}
+			};
+
+			// Tightest cluster (bit = 1) or largest void (bit = 0).
+			auto	Find	= [&]( char bit )
+			{
+				int		best	= -1;
+
+				for( int i = 0; i < count; i++ )
+				{
+					if( bit == iPattern[i] )
+					{
+						if(	(best < 0) ||
+							(1 == bit ? iEnergy[best] < iEnergy[i] : iEnergy[i] < iEnergy[best]) )
+						{
+							best	= i;
+						}
+					}
+				}
+
+				return	best;
+			};
+
+			// 1. Initial binary pattern, ~10% random minority pixels.
+			int		ones	= 0;
+
+			while( ones < (count / 10) )
+			{
+				seed	= seed * 1103515245 + 12345;
+
+				int		pos	= (seed >> 8) % count;
+
+				if( 0 == iPattern[pos] )
+				{
+					iPattern[pos]	= 1;
+					Splat( pos, 1.0f );
+					ones++;
+				}
+			}
+
+			// 2. Move the tightest cluster into the largest void until stable.
+			for( int i = 0; i < count; i++ )
+			{
+				int		cluster	= Find( 1 );
+
+				iPattern[cluster]	= 0;
+				Splat( cluster, -1.0f );
+
+				int		hole	= Find( 0 );
+
+				iPattern[hole]	= 1;
+				Splat( hole, 1.0f );
+
+				if( hole == cluster )
+				{
+					break;
+				}
+			}
+
+			std::vector<char>	iInitial	= iPattern;
+			std::vector<float>	iInitialE	= iEnergy;
+
+			// 3. Rank the initial pattern by removing tightest clusters.
+			for( int rank = ones - 1; 0 <= rank; rank-- )
+			{
+				int		cluster	= Find( 1 );
+
+				iPattern[cluster]	= 0;
+				Splat( cluster, -1.0f );
+				iRanks[cluster]		= rank;
+			}
+
+			// 4. Fill the largest voids for the remaining ranks.
+			iPattern	= iInitial;
+			iEnergy		= iInitialE;
+
+			for( int rank = ones; rank < count; rank++ )
+			{
+				int		hole	= Find( 0 );
+
+				iPattern[hole]	= 1;
+				Splat( hole, 1.0f );
+				iRanks[hole]	= rank;
+			}
+
+			return	iRanks;
+		}
+
+	protected:
+		int						m_nSize;
+		int						m_nPitch;
+		std::vector<uint8_t>	m_iTable;
+	};
+
+
+	//	Ordered dithering against a tiled threshold matrix.
+	//	(ox, oy) is the screen position of image (0,0); the matrix is anchored
+	//	to the screen, so partial updates join the surrounding area seamlessly
+	//	and a static image gives the same pattern every frame.
+	void	OrderedDither( uint8_t* image, int stride, int width, int height, const ThresholdMatrix& matrix, int ox = 0, int oy = 0 )
+	{
+		const int	size	= matrix.GetSize();
+
+		for( int y = 0; y < height; y++ )
+		{
+			uint8_t*	line	= image + stride * y;
+			int			x		= 0;
+
+#if IMAGE_HALFTONE_NEON || IMAGE_HALFTONE_SSE2
+			const uint8_t*	row		= matrix.GetRow( 0, oy + y );
+			int				phase	= matrix.Mod( ox );
+
+			for( ; (x+16) <= width; x += 16 )
+			{
+#if IMAGE_HALFTONE_NEON
+				uint8x16_t	v	= vld1q_u8( &line[x] );
+
+				vst1q_u8( &line[x], vcgtq_u8( v, vld1q_u8( &row[phase] ) ) );
+#else
+				__m128i		v	= _mm_loadu_si128( (const __m128i*)&line[x] );
+				__m128i		t	= _mm_loadu_si128( (const __m128i*)&row[phase] );
+
+				// v > t  <=>  saturate(v - t) != 0
+				v	= _mm_cmpeq_epi8( _mm_subs_epu8( v, t ), _mm_setzero_si128() );
+				_mm_storeu_si128( (__m128i*)&line[x], _mm_xor_si128( v, _mm_set1_epi8( -1 ) ) );
+#endif
+				phase	= (phase + 16) % size;
+			}
+#endif
+			const uint8_t*	th	= matrix.GetRow( 0, oy + y );
+
+			for( int i = matrix.Mod( ox + x ); x < width; x++ )
+			{
+				line[x]	= th[i] < line[x] ? 255 : 0;
+
+				i	= (i + 1) < size ? i + 1 : 0;
+			}
+		}
+	}
+
+
+	//	Generalised PatternDither_2x2: every size x size block (anchored to the
+	//	screen) is replaced by the matrix pattern of its average level.
+	void	PatternDither( uint8_t* image, int stride, int width, int height, const ThresholdMatrix& matrix, int ox = 0, int oy = 0 )
+	{
+		const int	size	= matrix.GetSize();
+
+		for( int by = -matrix.Mod( oy ); by < height; by += size )
+		{
+			int		y0	= by < 0 ? 0 : by;
+			int		y1	= (by + size) < height ? by + size : height;
+
+			for( int bx = -matrix.Mod( ox ); bx < width; bx += size )
+			{
+				int		x0	= bx < 0 ? 0 : bx;
+				int		x1	= (bx + size) < width ? bx + size : width;
+				int		sum	= 0;
+
+				for( int y = y0; y < y1; y++ )
+				{
+					for( int x = x0; x < x1; x++ )
+					{
+						sum	+= image[ stride * y + x ];
+					}
+				}
+
+				int		ave	= sum / ((y1 - y0) * (x1 - x0));
+
+				for( int y = y0; y < y1; y++ )
+				{
+					const uint8_t*	th	= matrix.GetRow( ox + x0, oy + y );
+
+					for( int x = x0; x < x1; x++ )
+					{
+						image[ stride * y + x ]	= th[ x - x0 ] < ave ? 255 : 0;
+					}
+				}
+			}
+		}
+	}
 };
 
 
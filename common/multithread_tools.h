@@ -1,7 +1,12 @@
+#ifndef	__MULTITHREAD_TOOLS_H_INCLUDED__
+#define	__MULTITHREAD_TOOLS_H_INCLUDED__
 
 
+#include <stdint.h>
 #include <thread>
 #include <vector>
+#include <mutex>
+#include <condition_variable>
 
 typedef unsigned long	( * THREAD_FUNCTION)( void * param );
 
@@ -65,3 +70,160 @@ public:
 			} );
 	};
 };
+
+//	Worker threads that stay alive between calls, for work that repeats.
+//	(halftoning each frame, rendering areas on each song change)
+//
+//	Execute( n, func ) runs func on n threads, the caller being one of them,
+//	and returns when all have returned, like CMultiThreadTools::DoExecute()
+//	without creating threads. func is expected to take its work items from
+//	a shared counter, so it gives the same result when fewer threads run
+//	it: a call made while the pool is busy (e.g. from inside a job) runs
+//	func on the caller alone.
+class CWorkerPool
+{
+public:
+	CWorkerPool()
+	{
+		m_pFunc			= NULL;
+		m_pParam		= NULL;
+		m_nGeneration	= 0;
+		m_nWanted		= 0;
+		m_nClaimed		= 0;
+		m_nPending		= 0;
+		m_isExiting		= false;
+	}
+
+	~CWorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex>	lock( m_iMutex );
+
+			m_isExiting	= true;
+		}
+
+		m_iStart.notify_all();
+
+		for( auto& thread : m_iThreads )
+		{
+			thread.join();
+		}
+	}
+
+	static	CWorkerPool&	GetDefault()
+	{
+		static	CWorkerPool	iPool;
+
+		return	iPool;
+	}
+
+	void	Execute( int nThreadCount, void* pParam, THREAD_FUNCTION pFunc )
+	{
+		if( nThreadCount == 0 )
+		{
+			nThreadCount	= CMultiThreadTools::GetProcessorCount();
+		}
+
+		std::unique_lock<std::mutex>	run( m_iRunMutex, std::try_to_lock );
+
+		if( (nThreadCount <= 1) || !run.owns_lock() )
+		{
+			pFunc( pParam );
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex>	lock( m_iMutex );
+
+			while( (int)m_iThreads.size() < (nThreadCount - 1) )
+			{
+				m_iThreads.push_back( std::thread( ThreadProc, this, m_nGeneration ) );
+			}
+
+			m_pFunc		= pFunc;
+			m_pParam	= pParam;
+			m_nWanted	= nThreadCount - 1;
+			m_nClaimed	= 0;
+			m_nPending	= nThreadCount - 1;
+			m_nGeneration++;
+		}
+
+		m_iStart.notify_all();
+
+		pFunc( pParam );
+
+		std::unique_lock<std::mutex>	lock( m_iMutex );
+
+		m_iDone.wait( lock, [&]{ return 0 == m_nPending; } );
+	}
+
+	template<typename Func>
+	void	Execute( int nThreadCount, Func& func )
+	{
+		Execute(
+			nThreadCount,
+			(void*)&func,
+			[](void* param)->unsigned long
+			{
+				(*(Func*)param)();
+				return	0;
+			} );
+	}
+
+protected:
+	// nSeen is the generation at creation, so a thread started for a job still takes it.
+	static	void	ThreadProc( CWorkerPool* piThis, uint64_t nSeen )
+	{
+		std::unique_lock<std::mutex>	lock( piThis->m_iMutex );
+
+		for( ;; )
+		{
+			piThis->m_iStart.wait( lock, [&]{ return piThis->m_isExiting || (nSeen != piThis->m_nGeneration); } );
+
+			if( piThis->m_isExiting )
+			{
+				return;
+			}
+
+			nSeen	= piThis->m_nGeneration;
+
+			// threads beyond the requested count sit this one out.
+			if( piThis->m_nWanted <= piThis->m_nClaimed )
+			{
+				continue;
+			}
+
+			piThis->m_nClaimed++;
+
+			THREAD_FUNCTION	pFunc	= piThis->m_pFunc;
+			void*			pParam	= piThis->m_pParam;
+
+			lock.unlock();
+			pFunc( pParam );
+			lock.lock();
+
+			if( 0 == --piThis->m_nPending )
+			{
+				piThis->m_iDone.notify_all();
+			}
+		}
+	}
+
+protected:
+	std::mutex					m_iRunMutex;	// one Execute() at a time
+	std::mutex					m_iMutex;
+	std::condition_variable		m_iStart;
+	std::condition_variable		m_iDone;
+	std::vector<std::thread>	m_iThreads;
+
+	// under m_iMutex
+	THREAD_FUNCTION				m_pFunc;
+	void*						m_pParam;
+	uint64_t					m_nGeneration;
+	int							m_nWanted;
+	int							m_nClaimed;
+	int							m_nPending;
+	bool						m_isExiting;
+};
+
+#endif
@@ -50,12 +50,17 @@ Volumio(Debian):
 #include <map>
 #include <string>
 #include <ctime>
+#include <atomic>
 #include <opencv2/opencv.hpp>
 
 #include "common/perf_log.h"
 #include "common/img_font.h"
+#include "common/img_glyph_atlas.h"
+#include "common/img_glyph_disk_cache.h"
+#include "common/multithread_tools.h"
 #include "common/ctrl_socket.h"
 #include "common/ctrl_http.h"
+#include "common/ctrl_mpd.h"
 #include "common/string_util.h"
 #include "common/ctrl_socket.h"
 #include "CoverArtExtractor.h"
@@ -81,6 +86,18 @@ Volumio(Debian):
 
 #define	FONT_PATH			"/usr/share/fonts/truetype/takao-gothic/TakaoPGothic.ttf"
 #define	FONT_DATE_PATH		"/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf"
+#define	GLYPH_CACHE_PATH	"/var/tmp/mpd_gui_glyphs.cache"
+
+// Codepoints FONT_PATH does not have are drawn from the first of these that
+// has them. (Latin / Cyrillic / Greek, Korean, CJK, symbols and emoji)
+// Missing files are skipped.
+static	const char*	g_pszFallbackFonts[]	=
+{
+	"/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf",
+	"/usr/share/fonts/truetype/nanum/NanumGothic.ttf",
+	"/usr/share/fonts/truetype/droid/DroidSansFallbackFull.ttf",
+	"/usr/share/fonts/truetype/ancient-scripts/Symbola_hint.ttf",
+};
 
 #define	MPD_HOST			"127.0.0.1"
 #define	MPD_PORT			6600
@@ -94,26 +111,6 @@ class MusicController
 {
 public:
 
-	static	std::map<std::string,std::string>	SplitMpdStatus( std::string &str )
-	{
-		std::map<std::string,std::string>	iInfo;
-		std::string			line;
-		std::istringstream	stream(str);
-		while( std::getline( stream, line ))
-		{
-			std::string::size_type	pos	= line.find( ":" );
-			if( pos != std::string::npos )
-			{
-				std::string	field( line, 0, pos );
-				std::string	value( line, pos+2 );
-				
-				iInfo[field]	= value;
-			}
-		}
-		
-		return	iInfo;
-	}
-
 	static	void	PlayPause()
 	{
 #if VOLUMIO
@@ -143,26 +140,26 @@ public:
 			}
 		}
 #else
-		Socket		iSock;
-		std::string	str;
+		MpdConnection	iConn;
+		const char*		data;
+		size_t			len;
 
-		iSock.connect( MPD_HOST, MPD_PORT );
-		
-		iSock	>> str;	// DummyRead
-		iSock	<< "status\n";
-		iSock	>> str;
+		if( !iConn.Connect( MPD_HOST, MPD_PORT ) || !iConn.Command( "status", data, len ) )
+		{
+			return;
+		}
+
+		MpdStatus	iStatus;
 
-		std::map<std::string,std::string>	iInfo	= SplitMpdStatus( str );
+		iStatus.Parse( data, len );
 
-		if( iInfo["state"] == "play" )
+		if( iStatus.Get( MpdStatus::FIELD_STATE ) == "play" )
 		{
-			iSock	<< "pause\n";
-			iSock	>> str;	// dummy read
+			iConn.Command( "pause" );
 		}
 		else
 		{
-			iSock	<< "play\n";
-			iSock	>> str;	// dummy read
+			iConn.Command( "play" );
 		}
 #endif
 	}
@@ -176,8 +173,10 @@ public:
 
 		{
 			ctrl_i2c		iic( "/dev/i2c-0",0x10 );
-			iic.write( dataL, 1 );
-			iic.read( &dataL[1], 1 );
+			ctrl_i2c::Batch	iBatch( iic );
+
+			// register read with repeated START, then all 4 register writes (L/R of 0x10 and 0x11) in one ioctl.
+			iic.write_read( dataL, 1, &dataL[1], 1 );
 
 			value		= dataL[1];
 
@@ -195,14 +194,11 @@ public:
 			dataL[1]	= value;
 			dataR[1]	= value;
 			
-			iic.write( dataL, 2 );
-			iic.write( dataR, 2 );
-		}
-
-		{
-			ctrl_i2c		iicR( "/dev/i2c-0",0x11 );
-			iicR.write( dataL, 2 );
-			iicR.write( dataR, 2 );
+			iBatch.write( 0x10, dataL, 2 );
+			iBatch.write( 0x10, dataR, 2 );
+			iBatch.write( 0x11, dataL, 2 );
+			iBatch.write( 0x11, dataR, 2 );
+			iBatch.commit();
 		}
 
 		if( 0 < value )
@@ -261,17 +257,20 @@ public:
 			return	"n/a";
 		}
 #else
-		Socket		iSock;
-		std::string	str;
+		MpdConnection	iConn;
+		const char*		data;
+		size_t			len;
 
-		iSock.connect( MPD_HOST, MPD_PORT );
-		
-		iSock	>> str;	// DummyRead
-		iSock	<< "status\n";
-		iSock	>> str;
+		if( !iConn.Connect( MPD_HOST, MPD_PORT ) || !iConn.Command( "status", data, len ) )
+		{
+			return	"n/a";
+		}
+
+		MpdStatus	iStatus;
 
-		std::map<std::string,std::string>	iInfo	= SplitMpdStatus( str );
-		int									value	= std::stoi( iInfo["volume"] );
+		iStatus.Parse( data, len );
+
+		int			value	= (int)iStatus.GetFloat( MpdStatus::FIELD_VOLUME, -1 );
 
 		if( 0 <= value )
 		{
@@ -280,12 +279,10 @@ public:
 
 			{
 				char		szBuf[256];
-				std::string	str;
 
-				sprintf( szBuf, "setvol %d\n", value );
+				sprintf( szBuf, "setvol %d", value );
 
-				iSock	<< szBuf;
-				iSock	>> str;	// Dummy read
+				iConn.Command( szBuf );
 
 				sprintf( szBuf, "%d", value );
 				return	szBuf;
@@ -307,12 +304,12 @@ public:
 
 		Http::Get( VOLUMIO_HOST, VOLUMIO_PORT, "/api/v1/commands/?cmd=next", iData );
 #else
-		Socket		iSock;
-		std::string	str;
+		MpdConnection	iConn;
 
-		iSock.connect( MPD_HOST, MPD_PORT );
-		iSock	<< "next\n";
-		iSock	>> str;
+		if( iConn.Connect( MPD_HOST, MPD_PORT ) )
+		{
+			iConn.Command( "next" );
+		}
 #endif
 	}
 
@@ -323,12 +320,12 @@ public:
 
 		Http::Get( VOLUMIO_HOST, VOLUMIO_PORT, "/api/v1/commands/?cmd=prev", iData );
 #else
-		Socket		iSock;
-		std::string	str;
+		MpdConnection	iConn;
 
-		iSock.connect( MPD_HOST, MPD_PORT );
-		iSock	<< "previous\n";
-		iSock	>> str;
+		if( iConn.Connect( MPD_HOST, MPD_PORT ) )
+		{
+			iConn.Command( "previous" );
+		}
 #endif
 	}
 };
@@ -384,6 +381,45 @@ void	Draw( cv::Mat& dst, int x, int y, cv::Mat& src )
 
 
 
+// Copy a 1bpp image (ImageBitPack rows, cx pixels) into dst of dst_cx pixels at x, y.
+void	DrawBits( cv::Mat& dst, int dst_cx, int x, int y, cv::Mat& src, int cx )
+{
+	int		src_x	= 0;
+	int		src_y	= 0;
+	int		cy		= src.rows;
+
+	if( x < 0 )
+	{
+		src_x	= -x;
+		cx		+= x;
+		x		= 0;
+	}
+
+	if( dst_cx < (x + cx) )
+	{
+		cx  = dst_cx - x;
+	}
+
+	if( y < 0 )
+	{
+		src_y	= -y;
+		cy		+= y;
+		y		= 0;
+	}
+
+	if( dst.rows < (y + cy) )
+	{
+		cy  = dst.rows - y;
+	}
+
+	for( int r = 0; (0 < cx) && (r < cy); r++ )
+	{
+		ImageBitPack::CopyBits( src.data + src.step * (src_y + r), src_x, dst.data + dst.step * (y + r), x, cx );
+	}
+}
+
+
+
 class DrawAreaIF
 {
 public:
@@ -394,17 +430,44 @@ public:
 		m_nRectY		= y;
 		m_nRectWidth	= cx;
 		m_nRectHeight	= cy;
+		m_nFields		= 0;
 		
 		m_iAreaImage	= cv::Mat::zeros( CV_8UC1, cy, cx );
 	}
 
-	virtual	void	UpdateInfo( std::map<std::string,std::string>& map )=0;
+	// Called every frame. changed: the fields of status that differ from the
+	// previous call, MpdStatus::ALL after Reset().
+	virtual	void	UpdateInfo( const MpdStatus& status, MpdStatus::Mask changed )=0;
+
+	// true if UpdateInfo( status ) has new content to render, which Prepare() can do ahead.
+	virtual	bool	NeedsPrepare( const MpdStatus& status, MpdStatus::Mask changed )
+	{
+		return	false;
+	}
+
+	// Render the content of status off screen, without touching the display.
+	// Runs on a worker thread, concurrently with Prepare() of the other areas.
+	virtual	void	Prepare( const MpdStatus& status )
+	{
+	}
 	
 	virtual	void	Reset()
 	{
 		m_nCurrent	= "";
 	}
 
+protected:
+	// The area shows this field. (IsChanged)
+	void	Subscribe( int field )
+	{
+		m_nFields	|= MpdStatus::Bit( field );
+	}
+
+	bool	IsChanged( MpdStatus::Mask changed ) const
+	{
+		return	0 != (changed & m_nFields);
+	}
+
 protected:
 	DisplayIF&	m_iDisp;
 	int			m_nRectX;
@@ -413,80 +476,167 @@ protected:
 	int			m_nRectHeight;
 	std::string	m_nCurrent;
 	cv::Mat		m_iAreaImage;
+
+	MpdStatus::Mask	m_nFields;		// Subscribe()
 };
 
 
-class DrawArea_STR : public DrawAreaIF
+// Single line text, rendered in the pixel format of the display:
+// 1bpp (mono hinted), RGB565 or BGRA. Text wider than the area scrolls.
+class DrawArea_Text : public DrawAreaIF
 {
 public:
-	DrawArea_STR( const std::string& tag, uint32_t color, DisplayIF& iDisplay, int x, int y, int cx, int cy, bool isRightAlign=false ) :
+	DrawArea_Text( uint32_t color, DisplayIF& iDisplay, int x, int y, int cx, int cy, bool isRightAlign ) :
 		DrawAreaIF( iDisplay, x, y, cx, cy ),
 		m_iFont( FONT_PATH, m_nRectHeight )
 	{
-		m_strTag		= tag;
 		m_nColor		= color;
 		m_isRightAlign	= isRightAlign;
+		m_nTextWidth	= 0;
+		m_nOffsetX		= 0;
+		m_isRendered	= false;
+		m_isCurrent		= false;
+
+		for( auto pszFont : g_pszFallbackFonts )
+		{
+			m_iFont.AddFallback( pszFont );
+		}
 	}
 
-	virtual	void	UpdateInfo( std::map<std::string,std::string>& map )
+	// Only the scroll runs unless the subscribed fields changed.
+	virtual	void	UpdateInfo( const MpdStatus& status, MpdStatus::Mask changed )
 	{
-		auto		it	= map.find( m_strTag );
-		std::string	str	= it != map.end() ? (*it).second : "";
+		if( !m_isCurrent || IsChanged( changed ) )
+		{
+			SetText( GetText( status ) );
+		}
 
-		if( m_nCurrent != str )
+		Scroll();
+	}
+
+	virtual	bool	NeedsPrepare( const MpdStatus& status, MpdStatus::Mask changed )
+	{
+		if( m_isCurrent && !IsChanged( changed ) )
 		{
-			int	l,t,r,b;
-			m_iFont.CalcRect( l,t,r,b, str.c_str() );
+			return	false;
+		}
+
+		return	!m_isRendered || (m_strRendered != GetText( status ));
+	}
+
+	virtual	void	Prepare( const MpdStatus& status )
+	{
+		RenderText( GetText( status ) );
+	}
+
+	virtual	void	Reset()
+	{
+		DrawAreaIF::Reset();
+		m_isCurrent	= false;
+	}
+
+protected:
+	virtual	const std::string&	GetText( const MpdStatus& status )=0;
+
+	// Layout and rasterise str into m_iImage, the display is not touched.
+	void	RenderText( const std::string& str )
+	{
+		if( m_isRendered && (m_strRendered == str) )
+		{
+			return;
+		}
+
+		m_iFont.SetMonoRendering( 1 == m_iDisp.GetBPP() );
+
+		TextRun	run	= m_iFont.Layout( str.c_str() );
+		int		r	= run.right;
+
+		switch( m_iDisp.GetBPP() )
+		{
+		case 1:
+			m_iImage	= cv::Mat::zeros( m_nRectHeight, (r + 7) / 8, CV_8UC1 );
+			m_iFont.DrawText1BPP( 0, 0, run, 255, m_iImage.data, m_iImage.step, r, m_iImage.rows );
+			break;
+
+		case 16:
+			m_iImage	= cv::Mat::zeros( m_nRectHeight, r, CV_8UC2 );
+			m_iFont.DrawTextRGB565( 0, 0, run, m_nColor, m_iImage.data, m_iImage.step, m_iImage.cols, m_iImage.rows );
+			break;
+
+		default:
+			m_iImage	= cv::Mat::zeros( m_nRectHeight, r, CV_8UC4 );
+			m_iFont.DrawTextBGRA( 0, 0, run, m_nColor, m_iImage.data, m_iImage.step, m_iImage.cols, m_iImage.rows );
+			break;
+		}
+
+		m_strRendered	= str;
+		m_nTextWidth	= r;
+		m_isRendered	= true;
+	}
+
+	// Present str, rendered now unless Prepare() did.
+	void	SetText( const std::string& str )
+	{
+		if( !m_isCurrent || (m_nCurrent != str) )
+		{
+			RenderText( str );
 
-			m_iAreaImage	= cv::Mat::zeros( m_nRectHeight, m_nRectWidth, CV_8UC4 );
-			m_iImage		= cv::Mat::zeros( m_nRectHeight, r, CV_8UC4 );
 			m_nCurrent		= str;
 			m_nOffsetX		= m_nRectWidth;
 
-			if( 1 < m_iDisp.GetBPP() )
-			{
-				m_iFont.DrawTextBGRA( 0, 0, str.c_str(), m_nColor, m_iImage.data, m_iImage.step, m_iImage.cols, m_iImage.rows );
-			}
-			else
-			{
-				cv::Mat	gray	= cv::Mat::zeros( m_iImage.rows, m_iImage.cols, CV_8UC1 );
+			WriteArea( m_isRightAlign && (m_nTextWidth < m_nRectWidth) ? m_nRectWidth - m_nTextWidth : 0 );
+		}
 
-				m_iFont.DrawTextGRAY( 0, 0, str.c_str(), 255, gray.data, gray.step, gray.cols, gray.rows );
-				
-				cv::threshold( gray, gray, 128, 255, CV_THRESH_BINARY );
-				cv::cvtColor( gray, m_iImage, CV_GRAY2BGRA );
-			}
-	
-			if( m_isRightAlign && (r < m_nRectWidth) )
-			{
-				Draw( m_iAreaImage, m_iAreaImage.cols-r, 0, m_iImage );
-			}
-			else
-			{
-				Draw( m_iAreaImage, 0, 0, m_iImage );
-			}
+		m_isCurrent	= true;
+	}
 
-			m_iDisp.WriteImageBGRA( m_nRectX, m_nRectY, m_iAreaImage.data, m_iAreaImage.step, m_iAreaImage.cols, m_iAreaImage.rows );
-		}
-		
-		if( m_nRectWidth < m_iImage.cols )
+	// Next step of a text wider than the area.
+	void	Scroll()
+	{
+		if( m_nRectWidth < m_nTextWidth )
 		{
 			int		x	= m_nOffsetX;
 			
 			x	= 0 < x ? 0 : x;
 
 			m_nOffsetX -= (m_iDisp.GetSize().width + 239) / 240;
-			m_nOffsetX	= -m_iImage.cols <= m_nOffsetX ? m_nOffsetX : m_nRectWidth;
+			m_nOffsetX	= -m_nTextWidth <= m_nOffsetX ? m_nOffsetX : m_nRectWidth;
 
-			m_iAreaImage	= cv::Mat::zeros( m_nRectHeight, m_nRectWidth, CV_8UC4 );
+			WriteArea( x );
+		}
+	}
+
+	// m_iImage at x, the rest of the area cleared.
+	void	WriteArea( int x )
+	{
+		if( 1 == m_iDisp.GetBPP() )
+		{
+			m_iAreaImage	= cv::Mat::zeros( m_nRectHeight, (m_nRectWidth + 7) / 8, CV_8UC1 );
+			DrawBits( m_iAreaImage, m_nRectWidth, x, 0, m_iImage, m_nTextWidth );
+			m_iDisp.WriteImage1BPP( m_nRectX, m_nRectY, m_iAreaImage.data, m_iAreaImage.step, m_nRectWidth, m_nRectHeight );
+		}
+		else
+		{
+			m_iAreaImage	= cv::Mat::zeros( m_nRectHeight, m_nRectWidth, m_iImage.type() );
 			Draw( m_iAreaImage, x, 0, m_iImage );
-			m_iDisp.WriteImageBGRA( m_nRectX, m_nRectY, m_iAreaImage.data, m_iAreaImage.step, m_iAreaImage.cols, m_iAreaImage.rows );
+
+			if( CV_8UC2 == m_iAreaImage.type() )
+			{
+				m_iDisp.WriteImageRGB565( m_nRectX, m_nRectY, m_iAreaImage.data, m_iAreaImage.step, m_iAreaImage.cols, m_iAreaImage.rows );
+			}
+			else
+			{
+				m_iDisp.WriteImageBGRA( m_nRectX, m_nRectY, m_iAreaImage.data, m_iAreaImage.step, m_iAreaImage.cols, m_iAreaImage.rows );
+			}
 		}
 	}
-	
+
 protected:
-	std::string	m_strTag;
-	cv::Mat		m_iImage;
+	cv::Mat		m_iImage;		// whole text, m_nTextWidth pixels
+	std::string	m_strRendered;	// text of m_iImage
+	bool		m_isRendered;
+	bool		m_isCurrent;	// m_nCurrent is on the display
+	int			m_nTextWidth;
 	int			m_nOffsetX;
 	bool		m_isRightAlign;
 	ImageFont	m_iFont;
@@ -494,101 +644,75 @@ protected:
 };
 
 
-class DrawArea_StaticText : public DrawAreaIF
+class DrawArea_STR : public DrawArea_Text
 {
 public:
-	DrawArea_StaticText( const std::string& text, uint32_t color, DisplayIF& iDisplay, int x, int y, int cx, int cy, bool isRightAlign=false ) :
-		DrawAreaIF( iDisplay, x, y, cx, cy ),
-		m_iFont( FONT_PATH, m_nRectHeight )
+	DrawArea_STR( const std::string& tag, uint32_t color, DisplayIF& iDisplay, int x, int y, int cx, int cy, bool isRightAlign=false ) :
+		DrawArea_Text( color, iDisplay, x, y, cx, cy, isRightAlign )
 	{
-		m_strText		= text;
-		m_nColor		= color;
-		m_isRightAlign	= isRightAlign;
+		m_nField		= GetField( tag );
+
+		Subscribe( m_nField );
 	}
 
-	virtual	void	UpdateInfo( std::map<std::string,std::string>& map )
+	// MpdStatus field of an MPD tag name.
+	static	int		GetField( const std::string& tag )
 	{
-		std::string	str	= m_strText;
+		int		field	= MpdStatus::GetFieldId( tag.c_str() );
 
-		if( m_nCurrent != str )
+		if( field < 0 )
 		{
-			int	l,t,r,b;
-			m_iFont.CalcRect( l,t,r,b, str.c_str() );
-
-			m_iAreaImage	= cv::Mat::zeros( m_nRectHeight, m_nRectWidth, CV_8UC4 );
-			m_iImage		= cv::Mat::zeros( m_nRectHeight, r, CV_8UC4 );
-			m_nCurrent		= str;
-			m_nOffsetX		= m_nRectWidth;
+			printf( "ERROR: unknown MPD field %s\n", tag.c_str() );
+			throw	"ERROR: unknown MPD field";
+		}
 
-			if( 1 < m_iDisp.GetBPP() )
-			{
-				m_iFont.DrawTextBGRA( 0, 0, str.c_str(), m_nColor, m_iImage.data, m_iImage.step, m_iImage.cols, m_iImage.rows );
-			}
-			else
-			{
-				cv::Mat	gray	= cv::Mat::zeros( m_iImage.rows, m_iImage.cols, CV_8UC1 );
+		return	field;
+	}
 
-				m_iFont.DrawTextGRAY( 0, 0, str.c_str(), 255, gray.data, gray.step, gray.cols, gray.rows );
-				
-				cv::threshold( gray, gray, 128, 255, CV_THRESH_BINARY );
-				cv::cvtColor( gray, m_iImage, CV_GRAY2BGRA );
-			}
+protected:
+	virtual	const std::string&	GetText( const MpdStatus& status )
+	{
+		return	status.Get( m_nField );
+	}
 	
-			if( m_isRightAlign && (r < m_nRectWidth) )
-			{
-				Draw( m_iAreaImage, m_iAreaImage.cols-r, 0, m_iImage );
-			}
-			else
-			{
-				Draw( m_iAreaImage, 0, 0, m_iImage );
-			}
+protected:
+	int			m_nField;
+};
 
-			m_iDisp.WriteImageBGRA( m_nRectX, m_nRectY, m_iAreaImage.data, m_iAreaImage.step, m_iAreaImage.cols, m_iAreaImage.rows );
-		}
-		
-		if( m_nRectWidth < m_iImage.cols )
-		{
-			int		x	= m_nOffsetX;
-			
-			x	= 0 < x ? 0 : x;
 
-			m_nOffsetX -= (m_iDisp.GetSize().width + 239) / 240;
-			m_nOffsetX	= -m_iImage.cols <= m_nOffsetX ? m_nOffsetX : m_nRectWidth;
+class DrawArea_StaticText : public DrawArea_Text
+{
+public:
+	DrawArea_StaticText( const std::string& text, uint32_t color, DisplayIF& iDisplay, int x, int y, int cx, int cy, bool isRightAlign=false ) :
+		DrawArea_Text( color, iDisplay, x, y, cx, cy, isRightAlign )
+	{
+		m_strText		= text;
+	}
 
-			m_iAreaImage	= cv::Mat::zeros( m_nRectHeight, m_nRectWidth, CV_8UC4 );
-			Draw( m_iAreaImage, x, 0, m_iImage );
-			m_iDisp.WriteImageBGRA( m_nRectX, m_nRectY, m_iAreaImage.data, m_iAreaImage.step, m_iAreaImage.cols, m_iAreaImage.rows );
-		}
+protected:
+	virtual	const std::string&	GetText( const MpdStatus& status )
+	{
+		return	m_strText;
 	}
 	
 protected:
 	std::string	m_strText;
-	cv::Mat		m_iImage;
-	int			m_nOffsetX;
-	bool		m_isRightAlign;
-	ImageFont	m_iFont;
-	uint32_t	m_nColor;
 };
 
 
 
-class DrawArea_MyIpAddr : public DrawAreaIF
+class DrawArea_MyIpAddr : public DrawArea_Text
 {
 public:
 	DrawArea_MyIpAddr( uint32_t color, DisplayIF& iDisplay, int x, int y, int cx, int cy, bool isRightAlign=false ) :
-		DrawAreaIF( iDisplay, x, y, cx, cy ),
-		m_iFont( FONT_PATH, m_nRectHeight )
+		DrawArea_Text( color, iDisplay, x, y, cx, cy, isRightAlign )
 	{
-		m_nColor		= color;
-		m_isRightAlign	= isRightAlign;
-		
 		m_iLastChecked	= std::chrono::high_resolution_clock::now();
 		m_strText		= Socket::GetMyIpAddrString();
 	}
 
-	virtual	void	UpdateInfo( std::map<std::string,std::string>& map )
+	virtual	void	UpdateInfo( const MpdStatus& status, MpdStatus::Mask changed )
 	{
-		
 		std::chrono::high_resolution_clock::time_point   current	= std::chrono::high_resolution_clock::now();
         double	elapsed = std::chrono::duration_cast<std::chrono::seconds>(current-m_iLastChecked).count();
 
@@ -605,69 +729,22 @@ public:
  			{
  				m_nColor	= 0xFFFFFFFF;
  			}
+
+			m_isCurrent		= false;
  		}
  		
-		if( m_nCurrent != m_strText )
-		{
-			m_nCurrent	= m_strText;
-
-			int	l,t,r,b;
-			m_iFont.CalcRect( l,t,r,b, m_strText.c_str() );
-
-			m_iAreaImage	= cv::Mat::zeros( m_nRectHeight, m_nRectWidth, CV_8UC4 );
-			m_iImage		= cv::Mat::zeros( m_nRectHeight, r, CV_8UC4 );
-			m_nCurrent		= m_strText;
-			m_nOffsetX		= m_nRectWidth;
-
-			if( 1 < m_iDisp.GetBPP() )
-			{
-				m_iFont.DrawTextBGRA( 0, 0, m_nCurrent.c_str(), m_nColor, m_iImage.data, m_iImage.step, m_iImage.cols, m_iImage.rows );
-			}
-			else
-			{
-				cv::Mat	gray	= cv::Mat::zeros( m_iImage.rows, m_iImage.cols, CV_8UC1 );
-
-				m_iFont.DrawTextGRAY( 0, 0, m_nCurrent.c_str(), 255, gray.data, gray.step, gray.cols, gray.rows );
-				
-				cv::threshold( gray, gray, 128, 255, CV_THRESH_BINARY );
-				cv::cvtColor( gray, m_iImage, CV_GRAY2BGRA );
-			}
-	
-			if( m_isRightAlign && (r < m_nRectWidth) )
-			{
-				Draw( m_iAreaImage, m_iAreaImage.cols-r, 0, m_iImage );
-			}
-			else
-			{
-				Draw( m_iAreaImage, 0, 0, m_iImage );
-			}
-
-			m_iDisp.WriteImageBGRA( m_nRectX, m_nRectY, m_iAreaImage.data, m_iAreaImage.step, m_iAreaImage.cols, m_iAreaImage.rows );
-		}
-		
-		if( m_nRectWidth < m_iImage.cols )
-		{
-			int		x	= m_nOffsetX;
-			
-			x	= 0 < x ? 0 : x;
-
-			m_nOffsetX -= (m_iDisp.GetSize().width + 239) / 240;
-			m_nOffsetX	= -m_iImage.cols <= m_nOffsetX ? m_nOffsetX : m_nRectWidth;
+		DrawArea_Text::UpdateInfo( status, changed );
+	}
 
-			m_iAreaImage	= cv::Mat::zeros( m_nRectHeight, m_nRectWidth, CV_8UC4 );
-			Draw( m_iAreaImage, x, 0, m_iImage );
-			m_iDisp.WriteImageBGRA( m_nRectX, m_nRectY, m_iAreaImage.data, m_iAreaImage.step, m_iAreaImage.cols, m_iAreaImage.rows );
-		}
+protected:
+	virtual	const std::string&	GetText( const MpdStatus& status )
+	{
+		return	m_strText;
 	}
 	
 protected:
    	std::chrono::high_resolution_clock::time_point	m_iLastChecked;
    	std::string										m_strText;
-	cv::Mat		m_iImage;
-	int			m_nOffsetX;
-	bool		m_isRightAlign;
-	ImageFont	m_iFont;
-	uint32_t	m_nColor;
 };
 
 
@@ -675,15 +752,21 @@ protected:
 class DrawArea_PlayPos: public DrawAreaIF
 {
 public:
-	DrawArea_PlayPos( DisplayIF& iDisplay, int x, int y, int cx, int cy ) : DrawAreaIF( iDisplay, x, y, cx, cy ){};
+	DrawArea_PlayPos( DisplayIF& iDisplay, int x, int y, int cx, int cy ) : DrawAreaIF( iDisplay, x, y, cx, cy )
+	{
+		Subscribe( MpdStatus::FIELD_TIME );
+		Subscribe( MpdStatus::FIELD_ELAPSED );
+	};
 
-	virtual	void	UpdateInfo( std::map<std::string,std::string>& map )
+	virtual	void	UpdateInfo( const MpdStatus& status, MpdStatus::Mask changed )
 	{
-		auto	itT			= map.find( "Time" );
-		auto	itE			= map.find( "elapsed" );
+		if( !IsChanged( changed ) )
+		{
+			return;
+		}
 
-		float	duration	= itT != map.end() ? std::stof( (*itT).second ) : 1;
-		float	elapsed		= itE != map.end() ? std::stof( (*itE).second ) : 0;
+		float	duration	= status.GetFloat( MpdStatus::FIELD_TIME, 1 );
+		float	elapsed		= status.GetFloat( MpdStatus::FIELD_ELAPSED );
 
 		m_iAreaImage	= cv::Mat::zeros( m_nRectHeight, m_nRectWidth, CV_8UC4 );
 
@@ -725,92 +808,222 @@ public:
 class DrawArea_CoverImage: public DrawAreaIF
 {
 public:
-	DrawArea_CoverImage( DisplayIF& iDisplay, int x, int y, int cx, int cy ) : DrawAreaIF( iDisplay, x, y, cx, cy ){};
+	DrawArea_CoverImage( DisplayIF& iDisplay, int x, int y, int cx, int cy ) :
+		DrawAreaIF( iDisplay, x, y, cx, cy ),
+		m_iFont( FONT_PATH, cy / 4 )
+	{
+		m_isPrepared	= false;
 
-	virtual	void	UpdateInfo( std::map<std::string,std::string>& map )
+		Subscribe( MpdStatus::FIELD_FILE );
+	}
+
+	virtual	void	UpdateInfo( const MpdStatus& status, MpdStatus::Mask changed )
 	{
-		auto		it	= map.find( "file" );
-		std::string	str	= it != map.end() ? (*it).second : "";
+		const std::string&	str	= status.Get( MpdStatus::FIELD_FILE );
 		
-		if( m_nCurrent != str )
+		if( IsChanged( changed ) && (m_nCurrent != str) )
 		{
 			m_nCurrent	= str;
 
-			// Create frame
-			cv::Mat	image	= cv::Mat::zeros( m_nRectHeight, m_nRectWidth, CV_8UC4 );
-			cv::Mat	cover;
+			Prepare( status );
 
-			cv::rectangle(
-				image,
-				cv::Point2i(0,0),
-				cv::Point2i(image.cols-1, image.rows-1),
-				cv::Scalar(255,255,255,255),
-				1 );
+			m_iDisp.WriteImageBGRA( m_nRectX, m_nRectY, m_iPrepared.data, m_iPrepared.step, m_iPrepared.cols, m_iPrepared.rows );
+		}
+	}
+
+	virtual	bool	NeedsPrepare( const MpdStatus& status, MpdStatus::Mask changed )
+	{
+		return	IsChanged( changed ) && (!m_isPrepared || (m_strPrepared != status.Get( MpdStatus::FIELD_FILE )));
+	}
+
+	// Decode, scale and frame the cover of the file.
+	virtual	void	Prepare( const MpdStatus& status )
+	{
+		const std::string&	str	= status.Get( MpdStatus::FIELD_FILE );
+
+		if( m_isPrepared && (m_strPrepared == str) )
+		{
+			return;
+		}
+
+		// Create frame
+		cv::Mat	image	= cv::Mat::zeros( m_nRectHeight, m_nRectWidth, CV_8UC4 );
+		cv::Mat	cover;
 
-			// Load music file
-			if( 0 != str.find("http://") )
+		cv::rectangle(
+			image,
+			cv::Point2i(0,0),
+			cv::Point2i(image.cols-1, image.rows-1),
+			cv::Scalar(255,255,255,255),
+			1 );
+
+		// Load music file
+		if( 0 != str.find("http://") )
+		{
+			std::string					path		= MUSIC_ROOT_PATH + str;
+			std::vector<unsigned char>	coverArt	= ExtractCoverArt( path.c_str() );
+
+			if( !coverArt.empty() )
 			{
-				std::string					path		= MUSIC_ROOT_PATH + str;
-				std::vector<unsigned char>	coverArt	= ExtractCoverArt( path.c_str() );
-	
-				if( !coverArt.empty() )
-				{
-					cover	= cv::imdecode( coverArt, cv::IMREAD_COLOR );
-				}
-	
-				if( cover.empty() )
-				{
-					path	= path.substr(0, path.rfind('/')+1 );
-					path	+= "front.jpg";
-	
-					cover	= cv::imread( path );
-				}
+				cover	= cv::imdecode( coverArt, cv::IMREAD_COLOR );
 			}
 
-			if( !cover.empty() )
+			if( cover.empty() )
 			{
-				cv::cvtColor( cover, cover, cv::COLOR_BGR2BGRA );
-				cv::resize( cover, cover, cv::Size(image.cols-2,image.rows-2), 0, 0, cv::INTER_AREA );
-				cover.copyTo( image( cv::Rect( 1, 1, cover.cols, cover.rows ) ) );
+				path	= path.substr(0, path.rfind('/')+1 );
+				path	+= "front.jpg";
+
+				cover	= cv::imread( path );
 			}
-			else
+		}
+
+		if( !cover.empty() )
+		{
+			cv::cvtColor( cover, cover, cv::COLOR_BGR2BGRA );
+			cv::resize( cover, cover, cv::Size(image.cols-2,image.rows-2), 0, 0, cv::INTER_AREA );
+			cover.copyTo( image( cv::Rect( 1, 1, cover.cols, cover.rows ) ) );
+		}
+		else
+		{
+			TextRun		run	= m_iFont.Layout( "NoImage" );
+			int			cx	= run.right - run.left;
+			int			cy	= run.bottom - run.top;
+
+			m_iFont.DrawTextBGRA(
+				(image.cols-cx)/2-run.left,
+				(image.rows-cy)/2-run.top,
+				run,
+				0xFFFFFFFF,
+				image.data, 
+				image.step,
+				image.cols,
+				image.rows );
+		}
+
+		m_iPrepared		= image;
+		m_strPrepared	= str;
+		m_isPrepared	= true;
+	}
+
+protected:
+	cv::Mat		m_iPrepared;
+	std::string	m_strPrepared;		// file of m_iPrepared
+	bool		m_isPrepared;
+	ImageFont	m_iFont;			// "NoImage"
+};
+
+
+// Text of a small fixed alphabet, composed from a GlyphAtlas.
+// Only the columns of the characters that changed are recomposed and sent.
+class DrawArea_Atlas: public DrawAreaIF
+{
+public:
+	DrawArea_Atlas( DisplayIF& iDisplay, int x, int y, int cx, int cy, const char* font, bool isFitHeight ) :
+		DrawAreaIF( iDisplay, x, y, cx, cy ),
+		m_iFont( font, m_nRectHeight, isFitHeight )
+	{
+		m_nOffsetX	= 0;
+		m_nOffsetY	= 0;
+		m_nCurrentX	= 0;
+		m_isDrawn	= false;
+	}
+
+	virtual	void	Reset()
+	{
+		DrawAreaIF::Reset();
+		m_isDrawn	= false;
+	}
+
+protected:
+	// alphabet is rendered for text at m_nOffsetY.
+	void	CreateAtlas( const char* alphabet )
+	{
+		m_iAtlas.Create( m_iFont, alphabet, m_nOffsetY, m_nRectHeight );
+	}
+
+	// type: CV_8UC4 (BGRA), CV_8UC2 (RGB565) or CV_8UC1 (GRAY, color is 255).
+	void	DrawText( int x, const char* str, uint32_t color = 0xFFFFFFFF, int type = CV_8UC1 )
+	{
+		int		l		= 0;
+		int		r		= m_nRectWidth;
+
+		if( m_isDrawn && (m_nCurrent == str) && (m_nCurrentX == x) )
+		{
+			return;
+		}
+
+		if( m_isDrawn && (type == m_iAreaImage.type()) )
+		{
+			if( !m_iAtlas.CalcDirty( m_nCurrentX, m_nCurrent.c_str(), x, str, l, r ) )
 			{
-				const char*	pszText	= "NoImage";
-				int			cx, cy, l,t,r,b;
-				ImageFont	iFont( FONT_PATH, image.rows / 4 );
-				
-				iFont.CalcRect( l,t,r,b, pszText );
-				cx	= r-l;
-				cy	= b-t;
-
-				iFont.DrawTextBGRA(
-					(image.cols-cx)/2-l,
-					(image.rows-cy)/2-t,
-					pszText,
-					0xFFFFFFFF,
-					image.data, 
-					image.step,
-					image.cols,
-					image.rows );
+				l	= 0;
+				r	= 0;
 			}
 
-			m_iDisp.WriteImageBGRA( m_nRectX, m_nRectY, image.data, image.step, image.cols, image.rows );
+			l	= 0 < l ? l : 0;
+			r	= r < m_nRectWidth ? r : m_nRectWidth;
+		}
+		else
+		{
+			m_iAreaImage	= cv::Mat::zeros( m_nRectHeight, m_nRectWidth, type );
+		}
+
+		m_nCurrent	= str;
+		m_nCurrentX	= x;
+		m_isDrawn	= true;
+
+		if( r <= l )
+		{
+			return;
+		}
+
+		uint8_t*	span	= m_iAreaImage.data + l * m_iAreaImage.elemSize();
+		int			step	= m_iAreaImage.step;
+
+		for( int y = 0; y < m_nRectHeight; y++ )
+		{
+			memset( span + step * y, 0, (r - l) * m_iAreaImage.elemSize() );
+		}
+
+		if( CV_8UC4 == type )
+		{
+			m_iAtlas.ComposeBGRA( x - l, str, color, span, step, r - l );
+			m_iDisp.WriteImageBGRA( m_nRectX + l, m_nRectY, span, step, r - l, m_nRectHeight );
+		}
+		else if( CV_8UC2 == type )
+		{
+			m_iAtlas.ComposeRGB565( x - l, str, color, span, step, r - l );
+			m_iDisp.WriteImageRGB565( m_nRectX + l, m_nRectY, span, step, r - l, m_nRectHeight );
+		}
+		else
+		{
+			m_iAtlas.ComposeGRAY( x - l, str, 255, span, step, r - l );
+			m_iDisp.WriteImageGRAY( m_nRectX + l, m_nRectY, span, step, r - l, m_nRectHeight );
 		}
 	}
+
+protected:
+	ImageFont	m_iFont;
+	GlyphAtlas	m_iAtlas;
+	int			m_nOffsetX;
+	int			m_nOffsetY;
+	int			m_nCurrentX;
+	bool		m_isDrawn;
 };
 
 
-class DrawArea_CpuTemp: public DrawAreaIF
+class DrawArea_CpuTemp: public DrawArea_Atlas
 {
 public:
 	DrawArea_CpuTemp( DisplayIF& iDisplay, int x, int y, int cx, int cy, bool isRightAlign=false ) : 
-		DrawAreaIF( iDisplay, x, y, cx, cy ),
-		m_iFont( FONT_PATH, m_nRectHeight )
+		DrawArea_Atlas( iDisplay, x, y, cx, cy, FONT_PATH, true )
 	{
 		m_isRightAlign	= isRightAlign;
+
+		CreateAtlas( "cpu 0123456789.-C" );
 	};
 
-	virtual	void	UpdateInfo( std::map<std::string,std::string>& map )
+	virtual	void	UpdateInfo( const MpdStatus& status, MpdStatus::Mask changed )
 	{
 		int			x = 0;
 		char		buf[128];
@@ -820,38 +1033,36 @@ public:
 
 		if( m_isRightAlign )
 		{
-			int	l,t,r,b;
-			m_iFont.CalcRect( l,t,r,b, buf );
+			int	l,r;
+			m_iAtlas.CalcSpan( buf, l, r );
 
 			x	= m_nRectWidth - r;
 		}
 
-		m_iAreaImage	= cv::Mat::zeros( m_nRectHeight, m_nRectWidth, CV_8UC1 );
-		m_iFont.DrawTextGRAY( x, 0, buf, 255, m_iAreaImage.data, m_iAreaImage.step, m_iAreaImage.cols, m_iAreaImage.rows );
-		m_iDisp.WriteImageGRAY( m_nRectX, m_nRectY, m_iAreaImage.data, m_iAreaImage.step, m_iAreaImage.cols, m_iAreaImage.rows );
+		DrawText( x, buf );
 	}
 
 protected:
-	ImageFont	m_iFont;
 	bool		m_isRightAlign;
 };
 
 
-class DrawArea_Date: public DrawAreaIF
+class DrawArea_Date: public DrawArea_Atlas
 {
 public:
 	DrawArea_Date( DisplayIF& iDisplay, int x, int y, int cx, int cy ) : 
-		DrawAreaIF( iDisplay, x, y, cx, cy ),
-		m_iFont( FONT_DATE_PATH, m_nRectHeight, false )
+		DrawArea_Atlas( iDisplay, x, y, cx, cy, FONT_DATE_PATH, false )
 	{
 		int	l,t,r,b;
 		m_iFont.CalcRect( l,t,r,b, "0000/00/00" );
 		
 		m_nOffsetX	= 0;//(cx - (r-l) + 1) / 2 - l;
 		m_nOffsetY	= (cy - (b-t) + 1) / 2 - t;
+
+		CreateAtlas( "0123456789/" );
 	};
 	
-	virtual	void	UpdateInfo( std::map<std::string,std::string>& map )
+	virtual	void	UpdateInfo( const MpdStatus& status, MpdStatus::Mask changed )
 	{
 		char			buf[32];
 		std::time_t 	t	= std::time(nullptr);
@@ -859,38 +1070,27 @@ public:
 
 		sprintf( buf, "%04d/%02d/%02d", 1900 + tl->tm_year, 1 + tl->tm_mon, tl->tm_mday );
 
-		if( m_nCurrent != buf )
-		{
-			m_nCurrent	= buf;
-
-			m_iAreaImage	= cv::Mat::zeros( m_nRectHeight, m_nRectWidth, CV_8UC1 );
-			m_iFont.DrawTextGRAY( m_nOffsetX, m_nOffsetY, buf, 255, m_iAreaImage.data, m_iAreaImage.step, m_iAreaImage.cols, m_iAreaImage.rows );
-			m_iDisp.WriteImageGRAY( m_nRectX, m_nRectY, m_iAreaImage.data, m_iAreaImage.step, m_iAreaImage.cols, m_iAreaImage.rows );
-		}
+		DrawText( m_nOffsetX, buf );
 	}
-
-protected:
-	ImageFont	m_iFont;
-	int			m_nOffsetX;
-	int			m_nOffsetY;
 };
 
 
-class DrawArea_Time: public DrawAreaIF
+class DrawArea_Time: public DrawArea_Atlas
 {
 public:
 	DrawArea_Time( DisplayIF& iDisplay, int x, int y, int cx, int cy ) : 
-		DrawAreaIF( iDisplay, x, y, cx, cy ),
-		m_iFont( FONT_DATE_PATH, m_nRectHeight, false )
+		DrawArea_Atlas( iDisplay, x, y, cx, cy, FONT_DATE_PATH, false )
 	{
 		int	l,t,r,b;
 		m_iFont.CalcRect( l,t,r,b, "88:88" );
 		
 		m_nOffsetX	= (cx - (r-l)) / 2 - l;		
 		m_nOffsetY	= (cy - (b-t)) / 2 - t;
+
+		CreateAtlas( "0123456789: " );
 	};
 	
-	virtual	void	UpdateInfo( std::map<std::string,std::string>& map )
+	virtual	void	UpdateInfo( const MpdStatus& status, MpdStatus::Mask changed )
 	{
 		char			buf[32];
 		std::time_t 	t	= std::time(nullptr);
@@ -901,20 +1101,80 @@ public:
 		else
 			sprintf( buf, "%02d:%02d", tl->tm_hour, tl->tm_min );
 
-		if( m_nCurrent != buf )
+		DrawText( m_nOffsetX, buf );
+	}
+};
+
+
+// Numeric value of tag, such as the volume, composed from a GlyphAtlas.
+// A value wider than the area is handed to a DrawArea_STR, which scrolls it.
+class DrawArea_Value: public DrawArea_Atlas
+{
+public:
+	DrawArea_Value( const std::string& tag, uint32_t color, DisplayIF& iDisplay, int x, int y, int cx, int cy, bool isRightAlign=false ) :
+		DrawArea_Atlas( iDisplay, x, y, cx, cy, FONT_PATH, true ),
+		m_iOverflow( tag, color, iDisplay, x, y, cx, cy, isRightAlign )
+	{
+		m_nField		= DrawArea_STR::GetField( tag );
+		m_nColor		= color;
+		m_isRightAlign	= isRightAlign;
+		m_isOverflow	= false;
+
+		Subscribe( m_nField );
+
+		// 1bpp: mono hinted cells (0x00 / 0xFF), the threshold text of DrawArea_Text.
+		m_iFont.SetMonoRendering( 1 == m_iDisp.GetBPP() );
+
+		CreateAtlas( "0123456789.-+ dBn/a" );
+	}
+
+	virtual	void	UpdateInfo( const MpdStatus& status, MpdStatus::Mask changed )
+	{
+		if( IsChanged( changed ) )
 		{
-			m_nCurrent	= buf;
+			const std::string&	str	= status.Get( m_nField );
+			int					l,r;
 
-			m_iAreaImage	= cv::Mat::zeros( m_nRectHeight, m_nRectWidth, CV_8UC1 );
-			m_iFont.DrawTextGRAY( m_nOffsetX, m_nOffsetY, buf, 255, m_iAreaImage.data, m_iAreaImage.step, m_iAreaImage.cols, m_iAreaImage.rows );
-			m_iDisp.WriteImageGRAY( m_nRectX, m_nRectY, m_iAreaImage.data, m_iAreaImage.step, m_iAreaImage.cols, m_iAreaImage.rows );
+			m_iAtlas.CalcSpan( str.c_str(), l, r );
+
+			// as DrawArea_Text, which scrolls when the text is wider than the area.
+			bool	isOverflow	= m_nRectWidth < r;
+
+			if( isOverflow != m_isOverflow )
+			{
+				// the other path draws the whole area next.
+				DrawArea_Atlas::Reset();
+				m_iOverflow.Reset();
+
+				m_isOverflow	= isOverflow;
+			}
+
+			if( !m_isOverflow )
+			{
+				int		bpp	= m_iDisp.GetBPP();
+
+				DrawText( m_isRightAlign ? m_nRectWidth - r : 0, str.c_str(), m_nColor, 16 == bpp ? CV_8UC2 : (1 < bpp ? CV_8UC4 : CV_8UC1) );
+			}
 		}
+
+		if( m_isOverflow )
+		{
+			m_iOverflow.UpdateInfo( status, changed );
+		}
+	}
+
+	virtual	void	Reset()
+	{
+		DrawArea_Atlas::Reset();
+		m_iOverflow.Reset();
 	}
 
 protected:
-	ImageFont	m_iFont;
-	int			m_nOffsetX;
-	int			m_nOffsetY;
+	int				m_nField;
+	bool			m_isRightAlign;
+	bool			m_isOverflow;		// m_iOverflow owns the area
+	uint32_t		m_nColor;
+	DrawArea_STR	m_iOverflow;
 };
 
 
@@ -964,7 +1224,12 @@ public:
 		////////////////////////////////////
 		// Connect to MPD
 		////////////////////////////////////
-		DISPLAY_MODE	ePrevDisplayMode;
+		m_iMpdClient.SetDerive( DeriveStatus );
+		m_iMpdClient.ThreadStart( MPD_HOST, MPD_PORT );
+
+		DISPLAY_MODE		ePrevDisplayMode;
+		MpdStatus			iStatus;
+		uint64_t			nStatusVersion	= 0;
 
 		ePrevDisplayMode	= DISPLAY_MODE_NONE;
 		m_eDisplayMode		= DISPLAY_MODE_NONE;
@@ -972,76 +1237,13 @@ public:
 
 		while( 1 )
 		{
-			std::map<std::string,std::string>	iInfo;
-	
 			///////////////////////////////////////////
-			// Receive current playback info.
+			// Current playback status, re-read by
+			// m_iMpdClient only when MPD changed it.
 			///////////////////////////////////////////
-			{
-				std::string	strStatus;
-		
-				{
-					Socket		iSock;
-					std::string	strCurrentSong;
-
-					if( 0 == iSock.connect( MPD_HOST, MPD_PORT ) )
-					{
-						try
-						{
-							iSock	>> strStatus;	// DummyRead
-
-							iSock	<< "currentsong\n";
-							iSock	>> strCurrentSong;
-							iSock	<< "status\n";
-							iSock	>> strStatus;
-						}
-						catch(...)
-						{
-						}
-					}
-
-					strStatus	+= strCurrentSong;
-				}
-
-//				printf( "%s\n", strStatus.c_str() );
-
-				iInfo		= MusicController::SplitMpdStatus( strStatus );
-
-				if( iInfo.find("state") == iInfo.end() )
-				{
-					iInfo["state"]	= "???";
-				}
+			MpdStatus::Mask	changed	= m_iMpdClient.GetStatus( iStatus, nStatusVersion );
 
-				if( iInfo.find("Date") != iInfo.end() )
-				{
-					iInfo["Date"]	= iInfo["Date"].substr( 0, 4 );
-				}
-				
-				auto	itF	= iInfo.find("file");
-				if( itF != iInfo.end() )
-				{
-					if( iInfo.find("Title") == iInfo.end() )
-					{
-						std::vector<std::string>	names	= StringUtil::SplitReverse( (*itF).second, "/", 3 );
-	
-						iInfo["Title"]	= names[0];
-						iInfo["Album"]	= names[1];
-						iInfo["Artist"]	= names[2];
-					}
-					else if( 0 == (*itF).second.find("http://") )
-					{
-						std::vector<std::string>	names	= StringUtil::Split( iInfo["Title"], " - ", 3 );
-						
-						iInfo["Artist"]	= names[0];
-						iInfo["Title"]	= names[1];
-						iInfo["Album"]	= names[2];
-						
-						iInfo["Album"]	= iInfo["Name"];
-					}
-				}
-			}
-
-			if( iInfo["state"] == "play" )
+			if( iStatus.Get( MpdStatus::FIELD_STATE ) == "play" )
 			{
 				m_eDisplayMode	= DISPLAY_MODE_SONGINFO;
 			}
@@ -1081,9 +1283,10 @@ public:
 			{
 				m_eDisplayMode	= DISPLAY_MODE_VOLUME;
 				
-				iInfo["volume"]	= MusicController::VolumeCtrl( 
-										(m_isButtonNextPressed ? 1 : 0) +
-										(m_isButtonPrevPressed ? -1 : 0) );
+				changed	|= iStatus.Set( MpdStatus::FIELD_VOLUME,
+										MusicController::VolumeCtrl( 
+											(m_isButtonNextPressed ? 1 : 0) +
+											(m_isButtonPrevPressed ? -1 : 0) ) );
 			}
 
 			if( m_eDisplayMode != ePrevDisplayMode )
@@ -1108,15 +1311,18 @@ public:
 					it->Reset();
 				}
 
+				changed				= MpdStatus::ALL;
 				ePrevDisplayMode	= m_eDisplayMode;
 			}
 
 			switch( m_eDisplayMode )
 			{
 			case DISPLAY_MODE_SONGINFO:
+				PrepareAreas( m_iDrawAreasSongInfo, iStatus, changed );
+
 				for( auto it : m_iDrawAreasSongInfo )
 				{
-					it->UpdateInfo( iInfo );
+					it->UpdateInfo( iStatus, changed );
 				}
 	
 				for( auto it : m_iDisplays )		
@@ -1128,9 +1334,11 @@ public:
 				break;
 				
 			case DISPLAY_MODE_IDLE:
+				PrepareAreas( m_iDrawAreasIdle, iStatus, changed );
+
 				for( auto it : m_iDrawAreasIdle )
 				{
-					it->UpdateInfo( iInfo );
+					it->UpdateInfo( iStatus, changed );
 				}
 	
 				for( auto it : m_iDisplays )		
@@ -1138,13 +1346,16 @@ public:
 					it->Flush();
 				}
 	
-				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+				// wakes up at once when playback starts.
+				m_iMpdClient.WaitChange( nStatusVersion, 100 );
 				break;
 
 			case DISPLAY_MODE_VOLUME:
+				PrepareAreas( m_iDrawAreasVolume, iStatus, changed );
+
 				for( auto it : m_iDrawAreasVolume )
 				{
-					it->UpdateInfo( iInfo );
+					it->UpdateInfo( iStatus, changed );
 				}
 	
 				for( auto it : m_iDisplays )		
@@ -1157,11 +1368,90 @@ public:
 			}
 		}
 	
+		m_iMpdClient.ThreadStop();
 		m_iGpioIntCtrl.ThreadStop();
 		return;
 	}
 
 protected:
+	// Render the new content of the areas concurrently (song change), so the
+	// UpdateInfo() pass that follows only writes the finished images.
+	// Threads of CWorkerPool::GetDefault(); the fonts of the areas share
+	// GlyphCache::GetDefault(), which ImageFont locks.
+	static	void	PrepareAreas( std::vector<DrawAreaIF*>& iDrawAreas, const MpdStatus& iStatus, MpdStatus::Mask changed )
+	{
+		std::vector<DrawAreaIF*>	iJobs;
+
+		if( 0 == changed )
+		{
+			return;
+		}
+
+		for( auto it : iDrawAreas )
+		{
+			if( it->NeedsPrepare( iStatus, changed ) )
+			{
+				iJobs.push_back( it );
+			}
+		}
+
+		if( iJobs.size() < 2 )
+		{
+			return;
+		}
+
+		std::atomic<size_t>	nNext( 0 );
+		int					nThreads	= CMultiThreadTools::GetProcessorCount();
+		auto				func		= [&]()
+		{
+			for( size_t i = nNext++; i < iJobs.size(); i = nNext++ )
+			{
+				iJobs[i]->Prepare( iStatus );
+			}
+		};
+
+		nThreads	= (int)iJobs.size() < nThreads ? (int)iJobs.size() : nThreads;
+
+		CWorkerPool::GetDefault().Execute( nThreads, func );
+	}
+
+	// Fields the display derives from what MPD sent. (MpdClient thread,
+	// once per change)
+	static	void	DeriveStatus( MpdStatus& iStatus )
+	{
+		if( !iStatus.Has( MpdStatus::FIELD_STATE ) )
+		{
+			iStatus.Set( MpdStatus::FIELD_STATE, "???" );
+		}
+
+		if( 4 < iStatus.Get( MpdStatus::FIELD_DATE ).size() )
+		{
+			iStatus.Set( MpdStatus::FIELD_DATE, iStatus.Get( MpdStatus::FIELD_DATE ).substr( 0, 4 ) );
+		}
+
+		const std::string&	file	= iStatus.Get( MpdStatus::FIELD_FILE );
+
+		if( !file.empty() )
+		{
+			if( !iStatus.Has( MpdStatus::FIELD_TITLE ) )
+			{
+				std::vector<std::string>	names	= StringUtil::SplitReverse( file, "/", 3 );
+
+				iStatus.Set( MpdStatus::FIELD_TITLE,	names[0] );
+				iStatus.Set( MpdStatus::FIELD_ALBUM,	names[1] );
+				iStatus.Set( MpdStatus::FIELD_ARTIST,	names[2] );
+			}
+			else if( 0 == file.find("http://") )
+			{
+				std::vector<std::string>	names	= StringUtil::Split( iStatus.Get( MpdStatus::FIELD_TITLE ), " - ", 3 );
+
+				iStatus.Set( MpdStatus::FIELD_ARTIST,	names[0] );
+				iStatus.Set( MpdStatus::FIELD_TITLE,	names[1] );
+				iStatus.Set( MpdStatus::FIELD_ALBUM,	iStatus.Get( MpdStatus::FIELD_NAME ) );
+			}
+		}
+	}
+
 	static	void	SetupLayout_SongInfo( std::vector<DrawAreaIF*>& iDrawAreas, DisplayIF* it )
 	{
 		int		x, y, csz, big, med, sml, ind;
@@ -1292,10 +1582,10 @@ protected:
 
 #ifdef VOLUME_CTRL_I2C_AK449x
 		iDrawAreas.push_back( new DrawArea_StaticText(	"volume",	white,	*it,	m,	oy,					cx - 2 * m, cy * 6 / 16 ) );
-		iDrawAreas.push_back( new DrawArea_STR( 		"volume",	white,	*it,	0,	oy + cy * 6 / 16,	cx        , cy * 6 / 16, true ) );
+		iDrawAreas.push_back( new DrawArea_Value(		"volume",	white,	*it,	0,	oy + cy * 6 / 16,	cx        , cy * 6 / 16, true ) );
 #else
 		iDrawAreas.push_back( new DrawArea_StaticText(	"volume",	white,	*it,	m,	oy,					cx - 2 * m, cy *  6 / 16 ) );
-		iDrawAreas.push_back( new DrawArea_STR( 		"volume",	white,	*it,	0,	oy + cy * 6 / 16,	cx - 2 * m, cy * 10 / 16, true ) );
+		iDrawAreas.push_back( new DrawArea_Value(		"volume",	white,	*it,	0,	oy + cy * 6 / 16,	cx - 2 * m, cy * 10 / 16, true ) );
 #endif
 	}
 
@@ -1436,6 +1726,7 @@ protected:
 	std::vector<DrawAreaIF*>	m_iDrawAreasIdle;
 	std::vector<DrawAreaIF*>	m_iDrawAreasVolume;
 	GpioInterruptCtrl			m_iGpioIntCtrl;
+	MpdClient					m_iMpdClient;
 
 	bool									m_isVolumeCtrlMode;
 	bool									m_isButtonNextPressed;
@@ -1448,6 +1739,12 @@ protected:
 
 int	main()
 {
+	// rendered glyphs of the previous runs, before any ImageFont.
+	std::vector<const char*>	iFonts	= { FONT_PATH, FONT_DATE_PATH };
+
+	iFonts.insert( iFonts.end(), std::begin( g_pszFallbackFonts ), std::end( g_pszFallbackFonts ) );
+	GlyphDiskCache::GetDefault().Open( GLYPH_CACHE_PATH, iFonts );
+
 	MpdGui	iMPD;
 	
 	if( !iMPD.Initialize() )
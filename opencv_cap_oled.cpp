@@ -44,7 +44,10 @@ int main()
 //			ImageHalftoning::ErrDiff_Burkes( dst.data, dst.step, dst.cols, dst.rows );
 //			ImageHalftoning::ErrDiff_Stucki( dst.data, dst.step, dst.cols, dst.rows );
 //			ImageHalftoning::ErrDiff_Atkinson( dst.data, dst.step, dst.cols, dst.rows );
+//			ImageHalftoning::ErrDiff_Sierra( dst.data, dst.step, dst.cols, dst.rows );
+//			ImageHalftoning::ErrDiff_JarvisJudiceNinke( dst.data, dst.step, dst.cols, dst.rows );
 //			ImageHalftoning::PatternDither_2x2( dst.data, dst.step, dst.cols, dst.rows );
+//			ImageHalftoning::OrderedDither( dst.data, dst.step, dst.cols, dst.rows, ImageHalftoning::ThresholdMatrix::BlueNoise() );
 		}
 
 //		cv::imwrite("src.png",src);
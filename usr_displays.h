@@ -2,6 +2,7 @@
 #include <vector>
 
 #include "common/display_ssd1306_i2c.h"	// Conflict to fbdev.h. Use exclusive.
+#include "common/display_ssd1306_spi.h"	// Conflict to fbdev.h. Use exclusive.
 //#include "common/display_fbdev.h"
 
 #include "common/display_st7735_spi.h"
@@ -17,6 +18,8 @@ std::vector<DisplayIF*>	GetUsrDisplays()
 
 //	iDisplays.push_back( new Display_SSD1306_i2c(180,0) );
 //	iDisplays.push_back( new Display_SSD1306_i2c(180,2) );	// for SH1306
+//	iDisplays.push_back( new Display_SSD1306_spi(180,0) );
+//	iDisplays.push_back( new Display_SSD1306_spi(180,2) );	// for SH1106
 
 //	iDisplays.push_back( new Display_ILI9341_spi_TM24(270,67) );
 //	iDisplays.push_back( new Display_ILI9341_spi_TM22(270) );